@@ -37,10 +37,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
 #include <stdint.h>
+#include <time.h>
 
 #ifdef _WIN32
 	#include <io.h>
@@ -53,6 +55,20 @@
 	#define isatty					_isatty
 	#define strcasecmp				_stricmp
 	#define strncasecmp				_strnicmp
+	typedef CRITICAL_SECTION		crossline_mutex_t;
+	#define crossline_mutex_init	InitializeCriticalSection
+	#define crossline_mutex_destroy	DeleteCriticalSection
+	#define crossline_mutex_lock	EnterCriticalSection
+	#define crossline_mutex_unlock	LeaveCriticalSection
+	typedef CONDITION_VARIABLE		crossline_cond_t;
+	#define crossline_cond_init		InitializeConditionVariable
+	#define crossline_cond_wait(c,m)	SleepConditionVariableCS (c, m, INFINITE)
+	#define crossline_cond_broadcast	WakeAllConditionVariable
+	#define crossline_atomic_cas(p,old,val)	(InterlockedCompareExchangePointer ((PVOID volatile*)(p), (val), (old)) == (PVOID)(old))
+	#define crossline_atomic_xchg(p,val)	InterlockedExchangePointer ((PVOID volatile*)(p), (val))
+	#define crossline_atomic_add(p,val)		(InterlockedExchangeAdd ((LONG volatile*)(p), (val)) + (val))
+	#define crossline_file_lock		_lock_file
+	#define crossline_file_unlock	_unlock_file
 	static int s_crossline_win = 1;
 #else
 	#include <unistd.h>
@@ -61,24 +77,64 @@
 	#include <signal.h>
 	#include <sys/ioctl.h>
 	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <time.h>
+	#include <poll.h>
+	#include <pthread.h>
+	#include <dirent.h>
+  #ifdef __linux__
+	#include <sys/syscall.h>
+  #endif
+	typedef pthread_mutex_t			crossline_mutex_t;
+	#define crossline_mutex_init(m)	pthread_mutex_init (m, NULL)
+	#define crossline_mutex_destroy	pthread_mutex_destroy
+	#define crossline_mutex_lock	pthread_mutex_lock
+	#define crossline_mutex_unlock	pthread_mutex_unlock
+	typedef pthread_cond_t			crossline_cond_t;
+	#define crossline_cond_init(c)	pthread_cond_init (c, NULL)
+	#define crossline_cond_wait		pthread_cond_wait
+	#define crossline_cond_broadcast	pthread_cond_broadcast
+	#define crossline_atomic_cas		__sync_bool_compare_and_swap
+	#define crossline_atomic_xchg		__sync_lock_test_and_set
+	#define crossline_atomic_add		__sync_add_and_fetch
+	#define crossline_file_lock		flockfile
+	#define crossline_file_unlock	funlockfile
 	static int s_crossline_win = 0;
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#include <emmintrin.h>
+	#define CROSS_FUZZY_SSE2
+#endif
+#if defined(__SSSE3__) && defined(__GNUC__)
+	#include <tmmintrin.h>
+	#define CROSS_WORD_SSSE3
+#endif
+
 #include "crossline.h"
 
 /*****************************************************************************/
 
 // Default word delimiters for move and cut
 #define CROSS_DFT_DELIMITER			" !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~"
+#define CROSS_DELIM_PROFILE_NUM		4		// Word delimiter profiles, 0 is set by crossline_delimiter_set
 
 #define CROSS_HISTORY_MAX_LINE		256		// Maximum history line number
 #define CROSS_HISTORY_BUF_LEN		4096	// History line length
 #define CROSS_HIS_MATCH_PAT_NUM		16		// History search pattern number
 
-#define CROSS_COMPLET_MAX_LINE		1024	// Maximum completion word number
-#define CROSS_COMPLET_WORD_LEN		64		// Completion word length
-#define CROSS_COMPLET_HELP_LEN		256		// Completion word's help length
-#define CROSS_COMPLET_HINT_LEN		128		// Completion syntax hints length
+#define CROSS_COMPLET_ARENA_BLK		16384	// Completion arena block size for words, help and hints
+#define CROSS_COMPLET_PROVIDER_MAX	8		// Maximum completion providers
+#define CROSS_COMPLET_THREADS		4		// Thread pool size to run completion providers
+#define CROSS_COMPLET_FUZZY_TOP		200		// Default best words kept by fuzzy matching
+#define CROSS_PATH_CACHE_NUM		8		// Directory listings cached by path completion
+#define CROSS_FRECENCY_HALF_LIFE	168		// Default hours for accepted count to decay half
+#define CROSS_FRECENCY_DOMINANT		4		// TAB completes top word if its score is so many times of second
+#define CROSS_LIVE_HINT_DELAY		100		// Default idle ms after typing before live hints are computed
+#define CROSS_PROMPT_BUF_LEN		1024	// Prompt text length got from dynamic prompt callback
+#define CROSS_PAGER_LINE_LEN		4096	// Line buffer length for pager line callback
+#define CROSS_PAGING_BUF_LEN		65536	// Paging writer block size, output is written once per block
+#define CROSS_ABOVE_PRINT_MS		30		// Minimum interval to print output above prompt, messages are batched
 
 // Make control-characters readable
 #define CTRL_KEY(key)				(key - 0x40)
@@ -188,29 +244,143 @@ enum {
 
 /*****************************************************************************/
 
+// Arena blocks are kept after reset and reused by next completion.
+typedef struct crossline_arena_blk_t {
+	struct crossline_arena_blk_t *next;
+	int		size, used;
+	char	data[1];
+} crossline_arena_blk_t;
+
+typedef struct crossline_arena_t {
+	crossline_arena_blk_t	*head, *cur;
+} crossline_arena_t;
+
+typedef struct crossline_completion_item_t {
+	const char	*word, *help;
+	crossline_color_e	color_word, color_help;
+} crossline_completion_item_t;
+
 typedef struct crossline_completions_t {
-	int		num;
-	char	word[CROSS_COMPLET_MAX_LINE][CROSS_COMPLET_WORD_LEN];
-	char	help[CROSS_COMPLET_MAX_LINE][CROSS_COMPLET_HELP_LEN];
-	char	hints[CROSS_COMPLET_HINT_LEN];
-	crossline_color_e	color_word[CROSS_COMPLET_MAX_LINE];
-	crossline_color_e	color_help[CROSS_COMPLET_MAX_LINE];
+	int		num, max;
+	int		common_len;	// Common prefix length known by source (ex. dictionary), -1 means unknown
+	int		monotonic;	// Results for longer prefix are always subset of these
+	int		cancelled;	// Async request is cancelled, callback can stop
+	int		limit;		// Maximum words to add, 0 is unlimited
+	crossline_mutex_t	*lock;	// Async request is filled by worker thread
+	struct crossline_completions_t	*parent; // Provider results are merged to parent
+	crossline_completion_item_t	*items;
+	const char	*hints;
 	crossline_color_e	color_hints;
+	crossline_arena_t	arena;	// Storage for copied words, help and hints
 } crossline_completions_t;
 
-static char		s_word_delimiter[64] = CROSS_DFT_DELIMITER;
+/* Word delimiter set compiled to class table indexed by byte, bytes >= 0x80 are word chars so UTF-8 
+ * text is word. lo/hi are nibble tables for SSSE3 16 bytes lookup, usable if all delimiters are ASCII.
+ */
+typedef struct crossline_delim_t {
+	char	delim[64];
+	uint8_t	cls[256];	// 1 for delimiter, '\0' is always delimiter and cls[0]=0 means not compiled
+	uint8_t	lo[16], hi[16];
+	int		simd;
+} crossline_delim_t;
+
+static crossline_delim_t s_delim_profile[CROSS_DELIM_PROFILE_NUM] = {{CROSS_DFT_DELIMITER, {0}, {0}, {0}, 0}};
+static crossline_delim_t *s_delim = &s_delim_profile[0];
 static char 	s_history_buf[CROSS_HISTORY_MAX_LINE][CROSS_HISTORY_BUF_LEN];
+static char 	s_history_fold[CROSS_HISTORY_MAX_LINE][CROSS_HISTORY_BUF_LEN]; // Case folded copy for search
 static uint32_t s_history_id = 0; // Increase always, wrap until UINT_MAX
 static char 	s_clip_buf[CROSS_HISTORY_BUF_LEN]; // Buf to store cut text
 static crossline_completion_callback s_completion_callback = NULL;
+static crossline_completions_t s_completions; // Reused by every completion in session
+static crossline_completions_t s_completion_cache; // Callback results kept for same or longer prefix
+static const char *s_cache_line		= NULL; // Line of cached results, NULL means no cache
+static uint64_t	s_cache_time		= 0;
+static int		s_cache_ttl			= 0; // Cache TTL in ms, 0 is disabled, <0 never expires
+static int		s_completion_latency = -1; // Last callback latency in ms
+static int		s_async_on			= 0; // Run completion callback in worker thread
+static int		s_async_deadline	= 0; // Apply partial results after deadline in ms, 0 is no deadline
+static struct crossline_async_job_t *s_async_job = NULL; // Running async completion
+static const char *s_ghost_hint		= NULL; // Ghost text instead of autosuggestion, ex. spinner
+static struct {
+	int			on, delay, len;	// len and hash identify line which hints are computed for
+	uint32_t	hash;
+	char		text[256];		// Hints shown as ghost text after input
+	crossline_completions_t	completions;
+} s_live_hint = {0, CROSS_LIVE_HINT_DELAY, -1, 0, {0}, {0}};
+static int		s_menu_on			= 0; // Menu completion
+static int		s_menu_rows			= 10; // Maximum menu rows
+static crossline_color_e s_menu_color = CROSSLINE_FGCOLOR_BLACK | CROSSLINE_BGCOLOR_WHITE; // Selected item
+static int		s_fuzzy_on			= 0; // Fuzzy match last word with registered dictionary and menu filter
+static int		s_fuzzy_top			= CROSS_COMPLET_FUZZY_TOP; // Best words kept by fuzzy matching
+static crossline_dict_t *s_completion_dict = NULL; // Registered dictionary to complete last word
+static crossline_grammar_t *s_completion_grammar = NULL; // Registered grammar
 static int		s_paging_print_line = 0; // For paging control
+// Paging writer: output is copied to block buffer and rows are counted while copying.
+static struct {
+	char		buf[CROSS_PAGING_BUF_LEN];
+	int			len;
+	int			tty;		// -1: not checked, 0: copy only, 1: count rows and pause
+	int			rows, cols, col;
+	int			esc;		// 1: after ESC, 2: in CSI sequence
+	int			need;		// UTF-8 continuation bytes to get
+	uint32_t	code;
+	int			quit;		// drop output until flush
+} s_paging_out = {{0}, 0, -1, 0, 0, 0, 0, 0, 0, 0};
+// Output printed above prompt from any thread: lock-free stack pushed by threads and taken all by editing thread.
+typedef struct crossline_msg_t {
+	struct crossline_msg_t	*next;
+	int			len;
+	char		text[1];
+} crossline_msg_t;
+static struct {
+	crossline_msg_t * volatile head; // newest first
+	int			pipe[2];	// wake editing thread when first message is pushed
+	int			on;			// editing thread waits for messages
+	volatile int editing;	// readline depth, changed atomically
+	volatile int hold;		// pager is shown, print after it, changed atomically
+	uint64_t	last;		// time of last print
+} s_above = {NULL, {-1, -1}, 0, 0, 0, 0};
 static int		s_got_resize 		= 0; // Window size changed
 static crossline_color_e s_prompt_color = CROSSLINE_COLOR_DEFAULT;
 
-static char* 	crossline_readline_edit (char *buf, int size, const char *prompt, int has_input, int in_his);
-static int		crossline_history_dump (FILE *file, int print_id, char *patterns, int sel_id, int paging);
+/* Prompt is parsed once to rendered bytes (SGR sequences are stripped for Windows console). Only the last line
+ * is redrawn with input, lines before it are printed by full print. Cells of last line are cached for columns.
+ */
+struct crossline_prompt_t {
+	char	*text;			// Rendered prompt
+	int		len, last;		// Rendered length, offset of last line
+	int		cols, cells;	// Cells of last line for cols
+	crossline_prompt_callback	func;	// Dynamic prompt
+	void	*arg;
+	volatile int	dirty;	// Call func again to get prompt
+};
 
-#define isdelim(ch)		(NULL != strchr(s_word_delimiter, ch))	// Check ch is word delimiter
+static int		s_autosuggest 		= 0; // Enable history autosuggestion
+static int		s_suggest_on 		= 0; // Autosuggestion is active in current edit
+static int		s_suggest_hide 		= 0; // Don't show ghost text for this refreash
+static uint32_t s_suggest_id 		= 0; // History id+1 of suggestion, 0 means no suggestion
+static int		s_suggest_len 		= -1; // Input length suggestion matched, -1 means not computed
+static int		s_ghost_len 		= 0; // Ghost text length printed after input
+static int		s_cur_cell			= -1; // Screen cell of cursor from prompt start, -1 for fresh line
+static int		s_end_cell			= -1; // Screen cell after input and ghost text
+static int		s_single_row		= 0; // Input is kept in one row and scrolled horizontally
+static int		s_row_off			= 0; // Visible input is [s_row_off, s_row_end) in single row mode
+static int		s_row_end			= 0;
+static crossline_color_e s_suggest_color = CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_BLACK;
+
+static char* 	crossline_readline_edit (char *buf, int size, crossline_prompt_t *prompt, int has_input, int in_his);
+static uint64_t	crossline_time_ms (void);
+static int		crossline_input_wait (int timeout_ms);
+static void		crossline_path_lock_init (void);
+static int		crossline_prompt_parse (crossline_prompt_t *pPrompt, const char *prompt);
+static int		crossline_prompt_render (crossline_prompt_t *pPrompt);
+static void		crossline_refreash (crossline_prompt_t *prompt, char *buf, int *pCurPos, int *pCurNum, int new_pos, int new_num, int bChg);
+typedef struct crossline_matcher_t crossline_matcher_t;
+static int		crossline_history_dump (FILE *file, int print_id, crossline_matcher_t *matcher, int sel_id, int paging);
+static int		crossline_pager_run (const char *title, int num, crossline_pager_callback pCbFunc, void *arg);
+static void		crossline_out_flush (char *out, int *pLen);
+
+#define isdelim(ch)		(s_delim->cls[(unsigned char)(ch)])	// Check ch is word delimiter
 
 // Debug macro.
 #if 0
@@ -290,6 +460,8 @@ static char* s_crossline_help[] = {
 " | F1                      |  Show search help when in search mode.           |",
 " | F2                      |  Show history.                                   |",
 " | F3                      |  Clear history (need confirm).                   |",
+" | Right, End (at end)     |  Accept autosuggestion. (If enabled)             |",
+" | Alt-F (at end)          |  Accept one word of autosuggestion.              |",
 " +-------------------------+--------------------------------------------------+",
 " Control Commands",
 " +-------------------------+--------------------------------------------------+",
@@ -314,6 +486,12 @@ static char* s_search_help[] = {
 "    -select:  choose line excluding 'select'",
 "    \"select from\":  choose line including \"select from\"",
 "    -\"select from\": choose line excluding \"select from\"",
+"    ^select:  choose line starting with 'select'",
+"    ^select*where:  choose line starting with 'select' and having 'where'",
+"              after it ('*' and '?' are wildcards in pattern anchored",
+"              with '^' or '$')",
+"    /sel.*fr(om|esh)/:  choose line matching regex ('.' '*' '+' '?' '|' '()'",
+"              '[]' '^' '$' are supported), use -/regex/ to exclude",
 "Example:",
 "    \"select from\" where -\"order by\" -limit:  ",
 "         choose line including \"select from\" and 'where'",
@@ -323,7 +501,7 @@ NULL};
 /*****************************************************************************/
 
 // Main API to read a line, return buf if get line, return NULL if EOF.
-static char* crossline_readline_internal (const char *prompt, char *buf, int size, int has_input)
+static char* crossline_readline_internal (crossline_prompt_t *prompt, char *buf, int size, int has_input)
 {
 	int not_support = 0, len;
 
@@ -348,32 +526,513 @@ static char* crossline_readline_internal (const char *prompt, char *buf, int siz
 
 	return crossline_readline_edit (buf, size, prompt, has_input, 0);
 }
+// Readline with prompt text which is parsed once for this call.
+static char* crossline_readline_text (char *buf, int size, const char *text, int has_input, int in_his)
+{
+	crossline_prompt_t prompt;
+	char *ret;
+
+	memset (&prompt, 0, sizeof(prompt));
+	if (crossline_prompt_parse (&prompt, (NULL != text) ? text : "") < 0)
+		{ prompt.text = (char*)""; } // no memory, no prompt
+	ret = in_his ? crossline_readline_edit (buf, size, &prompt, has_input, 1) : 
+					crossline_readline_internal (&prompt, buf, size, has_input);
+	if (prompt.len > 0)	{ free (prompt.text); }
+	return ret;
+}
 char* crossline_readline (const char *prompt, char *buf, int size)
 {
-	return crossline_readline_internal (prompt, buf, size, 0);
+	return crossline_readline_text (buf, size, prompt, 0, 0);
 }
 char* crossline_readline2 (const char *prompt, char *buf, int size)
 {
-	return crossline_readline_internal (prompt, buf, size, 1);
+	return crossline_readline_text (buf, size, prompt, 1, 0);
+}
+char* crossline_readline_prompt (crossline_prompt_t *pPrompt, char *buf, int size)
+{
+	crossline_prompt_t prompt;
+
+	if (NULL == pPrompt) {
+		memset (&prompt, 0, sizeof(prompt));
+		prompt.text = (char*)"";
+		pPrompt = &prompt;
+	} else if ((NULL != pPrompt->func) && pPrompt->dirty)
+		{ crossline_prompt_render (pPrompt); }
+	return crossline_readline_internal (pPrompt, buf, size, 0);
+}
+
+/*****************************************************************************/
+
+// Compile delimiter string to class table and nibble tables, empty string uses default delimiters.
+static void crossline_delim_build (crossline_delim_t *pDelim)
+{
+	const unsigned char *ch;
+	int i;
+
+	if ('\0' == pDelim->delim[0])	{ strcpy (pDelim->delim, CROSS_DFT_DELIMITER); }
+	memset (pDelim->cls, 0, sizeof(pDelim->cls));
+	memset (pDelim->lo, 0, sizeof(pDelim->lo));
+	memset (pDelim->hi, 0, sizeof(pDelim->hi));
+	pDelim->simd = 1;
+	for (ch = (const unsigned char*)pDelim->delim; ; ++ch) {
+		pDelim->cls[*ch] = 1;
+		if (*ch >= 0x80)	{ pDelim->simd = 0; }
+		else { pDelim->lo[*ch & 0x0F] |= (uint8_t)(1 << (*ch >> 4)); }
+		if ('\0' == *ch)	{ break; }
+	}
+	for (i = 0; i < 8; ++i)	{ pDelim->hi[i] = (uint8_t)(1 << i); } // high nibble 8-15 is non-ASCII
+}
+
+#ifdef CROSS_WORD_SSSE3
+// Bitmask of delimiter bytes in 16 bytes: class bit is looked up by low nibble and selected by high nibble.
+static uint32_t crossline_delim_mask16 (const char *text)
+{
+	__m128i v = _mm_loadu_si128 ((const __m128i*)text), nib = _mm_set1_epi8 (0x0F);
+	__m128i lo = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i*)s_delim->lo), _mm_and_si128 (v, nib));
+	__m128i hi = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i*)s_delim->hi), _mm_and_si128 (_mm_srli_epi16 (v, 4), nib));
+	return ~(uint32_t)_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_and_si128 (lo, hi), _mm_setzero_si128 ())) & 0xFFFF;
+}
+#endif
+
+// Find first pos in [pos,end) whose delimiter class is delim, return end if not found.
+static int crossline_word_find (const char *buf, int pos, int end, int delim)
+{
+#ifdef CROSS_WORD_SSSE3
+	uint32_t mask;
+	if (s_delim->simd) {
+		for (; pos + 16 <= end; pos += 16) {
+			mask = crossline_delim_mask16 (&buf[pos]);
+			if (!delim)	{ mask = ~mask & 0xFFFF; }
+			if (mask)	{ return pos + __builtin_ctz (mask); }
+		}
+	}
+#endif
+	for (; (pos < end) && (isdelim(buf[pos]) != delim); ++pos)	;
+	return pos;
+}
+
+// Find last pos in (stop,pos] whose delimiter class is delim, return stop if not found.
+static int crossline_word_rfind (const char *buf, int pos, int stop, int delim)
+{
+#ifdef CROSS_WORD_SSSE3
+	uint32_t mask;
+	if (s_delim->simd) {
+		for (; pos - 15 > stop; pos -= 16) {
+			mask = crossline_delim_mask16 (&buf[pos-15]);
+			if (!delim)	{ mask = ~mask & 0xFFFF; }
+			if (mask)	{ return pos - 15 + (31 - __builtin_clz (mask)); }
+		}
+	}
+#endif
+	for (; (pos > stop) && (isdelim(buf[pos]) != delim); --pos)	;
+	return pos;
 }
 
 // Set move/cut word delimiter, defaut is all not digital and alphabetic characters.
 void  crossline_delimiter_set (const char *delim)
 {
-	if (NULL != delim) {
-		strncpy (s_word_delimiter, delim, sizeof(s_word_delimiter) - 1);
-		s_word_delimiter[sizeof(s_word_delimiter) - 1] = '\0';
+	crossline_delimiter_profile_set (0, delim);
+}
+
+int  crossline_delimiter_profile_set (int profile, const char *delim)
+{
+	crossline_delim_t *pDelim;
+
+	if ((profile < 0) || (profile >= CROSS_DELIM_PROFILE_NUM) || (NULL == delim))	{ return -1; }
+	pDelim = &s_delim_profile[profile];
+	strncpy (pDelim->delim, delim, sizeof(pDelim->delim) - 1);
+	pDelim->delim[sizeof(pDelim->delim) - 1] = '\0';
+	crossline_delim_build (pDelim);
+	return 0;
+}
+
+int  crossline_delimiter_profile_use (int profile)
+{
+	int old = (int)(s_delim - s_delim_profile);
+
+	if ((profile < 0) || (profile >= CROSS_DELIM_PROFILE_NUM))	{ return -1; }
+	s_delim = &s_delim_profile[profile];
+	if (0 == s_delim->cls[0])	{ crossline_delim_build (s_delim); }
+	return old;
+}
+
+/* Case fold src to dst (can be same), folded text keeps same byte length.
+ * ASCII is folded 8 bytes a time, UTF-8 Latin-1, Greek and Cyrillic capitals are folded also,
+ * other multi-byte characters are copied unchanged.
+ */
+static int crossline_str_fold (char *dst, const char *src)
+{
+	int len = 0, end = (int)strlen (src);
+	uint64_t w, m;
+	unsigned char ch, ch2;
+
+	while (len < end) {
+		for (; len + 8 <= end; len += 8) { // word at a time, stop at non-ASCII
+			memcpy (&w, &src[len], 8);
+			if (w & 0x8080808080808080ULL)	{ break; }
+			m = (w + 0x3f3f3f3f3f3f3f3fULL) & ~(w + 0x2525252525252525ULL) & 0x8080808080808080ULL;
+			w |= m >> 2; // 'A'-'Z' -> 'a'-'z'
+			memcpy (&dst[len], &w, 8);
+		}
+		for (; (len < end) && !(src[len] & 0x80); ++len)
+			{ dst[len] = (char)tolower (src[len]); }
+		if (len >= end)	{ break; }
+		ch = (unsigned char)src[len];
+		ch2 = (unsigned char)src[len+1];
+		dst[len] = src[len];
+		if ((ch2 & 0xC0) != 0x80) { len++; continue; } // invalid or end, copy lead byte only
+		if ((0xC3 == ch) && (ch2 >= 0x80) && (ch2 <= 0x9E) && (0x97 != ch2)) {
+			ch2 += 0x20;					// U+00C0-U+00DE
+		} else if ((0xCE == ch) && (ch2 >= 0x91) && (ch2 <= 0x9F)) {
+			ch2 += 0x20;					// U+0391-U+039F
+		} else if ((0xCE == ch) && (ch2 >= 0xA0) && (ch2 <= 0xA9) && (0xA2 != ch2)) {
+			dst[len] = (char)0xCF; ch2 -= 0x20;	// U+03A0-U+03A9
+		} else if ((0xD0 == ch) && (ch2 >= 0x80) && (ch2 <= 0x8F)) {
+			dst[len] = (char)0xD1; ch2 += 0x10;	// U+0400-U+040F
+		} else if ((0xD0 == ch) && (ch2 >= 0x90) && (ch2 <= 0x9F)) {
+			ch2 += 0x20;					// U+0410-U+041F
+		} else if ((0xD0 == ch) && (ch2 >= 0xA0) && (ch2 <= 0xAF)) {
+			dst[len] = (char)0xD1; ch2 -= 0x20;	// U+0420-U+042F
+		}
+		dst[len+1] = (char)ch2;
+		len += 2;
+		for (; (len < end) && ((src[len] & 0xC0) == 0x80); ++len)	// rest continuation bytes
+			{ dst[len] = src[len]; }
+	}
+	dst[len] = '\0';
+	return len;
+}
+
+// Decode UTF-8 char at str to code point, return byte length (invalid byte is taken as 1 byte char).
+static int crossline_utf8_decode (const char *str, uint32_t *pCode)
+{
+	const unsigned char *s = (const unsigned char*)str;
+	int len, i;
+
+	if (s[0] < 0x80)	{ *pCode = s[0]; return s[0] ? 1 : 0; }
+	if ((s[0] & 0xE0) == 0xC0)		{ len = 2; *pCode = s[0] & 0x1F; }
+	else if ((s[0] & 0xF0) == 0xE0)	{ len = 3; *pCode = s[0] & 0x0F; }
+	else if ((s[0] & 0xF8) == 0xF0)	{ len = 4; *pCode = s[0] & 0x07; }
+	else	{ *pCode = s[0]; return 1; }
+	for (i = 1; i < len; ++i) {
+		if ((s[i] & 0xC0) != 0x80)	{ *pCode = s[0]; return 1; }
+		*pCode = (*pCode << 6) | (s[i] & 0x3F);
+	}
+	return len;
+}
+
+// Zero width (combining marks, format chars) and East Asian wide/emoji ranges, sorted.
+static const uint32_t s_width_zero[][2] = {
+	{0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x05BF, 0x05BF}, {0x05C1, 0x05C2}, 
+	{0x05C4, 0x05C5}, {0x05C7, 0x05C7}, {0x0610, 0x061A}, {0x064B, 0x065F}, {0x0670, 0x0670}, 
+	{0x06D6, 0x06DC}, {0x06DF, 0x06E4}, {0x06E7, 0x06E8}, {0x06EA, 0x06ED}, {0x0900, 0x0902}, 
+	{0x093A, 0x093A}, {0x093C, 0x093C}, {0x0941, 0x0948}, {0x094D, 0x094D}, {0x0951, 0x0957}, 
+	{0x0962, 0x0963}, {0x0E31, 0x0E31}, {0x0E34, 0x0E3A}, {0x0E47, 0x0E4E}, {0x1AB0, 0x1AFF}, 
+	{0x1DC0, 0x1DFF}, {0x200B, 0x200F}, {0x202A, 0x202E}, {0x2060, 0x2064}, {0x20D0, 0x20FF}, 
+	{0xFE00, 0xFE0F}, {0xFE20, 0xFE2F}, {0x1F3FB, 0x1F3FF}, {0xE0100, 0xE01EF}
+};
+static const uint32_t s_width_wide[][2] = {
+	{0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A}, {0x23E9, 0x23EC}, {0x23F0, 0x23F0}, 
+	{0x23F3, 0x23F3}, {0x25FD, 0x25FE}, {0x2614, 0x2615}, {0x2648, 0x2653}, {0x267F, 0x267F}, 
+	{0x2693, 0x2693}, {0x26A1, 0x26A1}, {0x26AA, 0x26AB}, {0x26BD, 0x26BE}, {0x26C4, 0x26C5}, 
+	{0x26CE, 0x26CE}, {0x26D4, 0x26D4}, {0x26EA, 0x26EA}, {0x26F2, 0x26F3}, {0x26F5, 0x26F5}, 
+	{0x26FA, 0x26FA}, {0x26FD, 0x26FD}, {0x2705, 0x2705}, {0x270A, 0x270B}, {0x2728, 0x2728}, 
+	{0x274C, 0x274C}, {0x274E, 0x274E}, {0x2753, 0x2755}, {0x2757, 0x2757}, {0x2795, 0x2797}, 
+	{0x27B0, 0x27B0}, {0x27BF, 0x27BF}, {0x2B1B, 0x2B1C}, {0x2B50, 0x2B50}, {0x2B55, 0x2B55}, 
+	{0x2E80, 0x303E}, {0x3041, 0x33FF}, {0x3400, 0x4DBF}, {0x4E00, 0x9FFF}, {0xA000, 0xA4CF}, 
+	{0xA960, 0xA97F}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF}, {0xFE10, 0xFE19}, {0xFE30, 0xFE6F}, 
+	{0xFF00, 0xFF60}, {0xFFE0, 0xFFE6}, {0x16FE0, 0x16FE4}, {0x17000, 0x18AFF}, {0x1B000, 0x1B2FF}, 
+	{0x1F004, 0x1F004}, {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A}, {0x1F200, 0x1F2FF}, 
+	{0x1F300, 0x1F3FA}, {0x1F400, 0x1F64F}, {0x1F680, 0x1F6FF}, {0x1F7E0, 0x1F7EB}, {0x1F90C, 0x1F9FF}, 
+	{0x1FA70, 0x1FAFF}, {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD}
+};
+
+// Two-level width table: s_width_index maps each 256 code point block to 0/1/2 if the whole block has 
+// that width, otherwise to 3 + index of a mixed block in s_width_block which packs 2 bits per code point.
+#define CROSS_WIDTH_BLOCK_MAX	96
+static uint8_t	s_width_index[0x110000 >> 8];
+static uint8_t	s_width_block[CROSS_WIDTH_BLOCK_MAX][64];
+static int		s_width_ready = 0;
+
+// Width by scanning range lists, only used to build lookup table.
+static int crossline_width_range (uint32_t code)
+{
+	unsigned int i;
+
+	if ((code < 0x20) || ((code >= 0x7F) && (code < 0xA0)))	{ return 0; }
+	for (i = 0; i < sizeof(s_width_zero) / sizeof(s_width_zero[0]); ++i) {
+		if ((code >= s_width_zero[i][0]) && (code <= s_width_zero[i][1]))	{ return 0; }
+	}
+	for (i = 0; i < sizeof(s_width_wide) / sizeof(s_width_wide[0]); ++i) {
+		if ((code >= s_width_wide[i][0]) && (code <= s_width_wide[i][1]))	{ return 2; }
+	}
+	return 1;
+}
+
+// Check if width may change inside block, i.e. any range starts or ends inside it.
+static int crossline_width_mixed (uint32_t base)
+{
+	unsigned int i;
+
+	if (0 == base)	{ return 1; }	// control chars
+	for (i = 0; i < sizeof(s_width_zero) / sizeof(s_width_zero[0]); ++i) {
+		if (((s_width_zero[i][0] > base) && (s_width_zero[i][0] <= base + 0xFF)) || 
+			((s_width_zero[i][1] >= base) && (s_width_zero[i][1] < base + 0xFF)))	{ return 1; }
+	}
+	for (i = 0; i < sizeof(s_width_wide) / sizeof(s_width_wide[0]); ++i) {
+		if (((s_width_wide[i][0] > base) && (s_width_wide[i][0] <= base + 0xFF)) || 
+			((s_width_wide[i][1] >= base) && (s_width_wide[i][1] < base + 0xFF)))	{ return 1; }
+	}
+	return 0;
+}
+
+static void crossline_width_init (void)
+{
+	uint32_t blk, code;
+	int mixed = 0;
+
+	for (blk = 0; blk < sizeof(s_width_index); ++blk) {
+		if (!crossline_width_mixed (blk << 8) || (mixed >= CROSS_WIDTH_BLOCK_MAX)) {
+			s_width_index[blk] = (uint8_t)crossline_width_range (blk << 8);
+			continue;
+		}
+		for (code = 0; code < 256; ++code) {
+			s_width_block[mixed][code >> 2] |= (uint8_t)(crossline_width_range ((blk << 8) | code) << ((code & 3) * 2));
+		}
+		s_width_index[blk] = (uint8_t)(3 + mixed++);
+	}
+	s_width_ready = 1;
+}
+
+// Display cells of code point: 0 for control and combining marks, 2 for East Asian wide and emoji, otherwise 1.
+static int crossline_char_width (uint32_t code)
+{
+	int idx;
+
+	if (code < 0x300)	{ return ((code < 0x20) || ((code >= 0x7F) && (code < 0xA0))) ? 0 : 1; }
+	if (code >= 0x110000)	{ return 1; }
+	if (!s_width_ready)	{ crossline_width_init (); }
+	idx = s_width_index[code >> 8];
+	if (idx < 3)	{ return idx; }
+	return (s_width_block[idx - 3][(code & 0xFF) >> 2] >> ((code & 3) * 2)) & 3;
+}
+
+// Advance screen cell offset over len bytes of UTF-8 text, cols > 0 to wrap wide char which doesn't fit 
+// at row end to next row as terminal does. Pure ASCII runs are counted 8 bytes a time without decoding.
+static int crossline_cell_add (int cell, const char *text, int len, int cols)
+{
+	int i = 0, n, width;
+	uint32_t code;
+	uint64_t word;
+
+	while (i < len) {
+		for (; i + 8 <= len; i += 8, cell += 8) {
+			memcpy (&word, text + i, 8);
+			if (word & 0x8080808080808080ULL)	{ break; }
+		}
+		for (; (i < len) && !(text[i] & 0x80); ++i, ++cell)
+			;
+		if (i >= len)	{ break; }
+		n = crossline_utf8_decode (text + i, &code);
+		if ((n <= 1) || (i + n > len))	{ n = 1; code = 0xFFFD; } // invalid or code page byte takes 1 cell
+		width = crossline_char_width (code);
+		if ((2 == width) && (cols > 1) && ((cell % cols) == cols - 1))	{ cell++; }
+		cell += width;
+		i += n;
+	}
+	return cell;
+}
+
+// Display cells of UTF-8 string.
+static int crossline_str_width (const char *str)
+{
+	return crossline_cell_add (0, str, (int)strlen(str), 0);
+}
+
+// Print UTF-8 text clipped to max cells, return cells printed.
+static int crossline_cells_print (const char *text, int max)
+{
+	int len = 0, cell = 0, n, width;
+	uint32_t code;
+
+	for (; (n = crossline_utf8_decode (&text[len], &code)) > 0; len += n) {
+		width = (code < 0x80) ? 1 : crossline_char_width (code);
+		if (cell + width > max)	{ break; }
+		cell += width;
+	}
+	printf ("%.*s", len, text);
+	return cell;
+}
+
+// Swap text [beg,mid) and [mid,end) in place by three reversals.
+static void crossline_text_rotate (char *buf, int beg, int mid, int end)
+{
+	int i, j, k, ch;
+	int range[3][2] = {{beg, mid - 1}, {mid, end - 1}, {beg, end - 1}};
+
+	for (k = 0; k < 3; ++k) {
+		for (i = range[k][0], j = range[k][1]; i < j; ++i, --j)
+			{ ch = buf[i]; buf[i] = buf[j]; buf[j] = (char)ch; }
+	}
+}
+
+// Byte position of previous grapheme start: skip back over continuation bytes and zero width marks.
+static int crossline_char_prev (const char *buf, int pos)
+{
+	uint32_t code;
+
+	while (pos > 0) {
+		for (--pos; (pos > 0) && ((buf[pos] & 0xC0) == 0x80); --pos)
+			;
+		if ((pos == 0) || !(buf[pos] & 0x80))	{ break; }
+		crossline_utf8_decode (buf + pos, &code);
+		if (0 != crossline_char_width (code))	{ break; }
+	}
+	return pos;
+}
+
+// Byte position of next grapheme start: skip current char and following zero width marks.
+static int crossline_char_next (const char *buf, int pos, int num)
+{
+	uint32_t code;
+	int len;
+
+	if (pos >= num)	{ return num; }
+	len = crossline_utf8_decode (buf + pos, &code);
+	for (pos += (len > 0) ? len : 1; (pos < num) && (buf[pos] & 0x80); pos += len) {
+		len = crossline_utf8_decode (buf + pos, &code);
+		if ((len <= 0) || (0 != crossline_char_width (code)))	{ break; }
+	}
+	return (pos > num) ? num : pos;
+}
+
+/*****************************************************************************/
+
+// Parse prompt to rendered text and find last line, return -1 if no memory.
+static int crossline_prompt_parse (crossline_prompt_t *pPrompt, const char *prompt)
+{
+	int i, n = 0, len = (int)strlen (prompt);
+	char *text = (char*)realloc ((pPrompt->len > 0) ? pPrompt->text : NULL, len + 1);
+
+	if (NULL == text)	{ return -1; }
+	pPrompt->last = 0;
+	for (i = 0; i < len; ++i) {
+		if (s_crossline_win && ('\x1b' == prompt[i]) && ('[' == prompt[i+1])) { // console doesn't take SGR
+			for (i += 2; (i < len) && ((prompt[i] < 0x40) || (prompt[i] > 0x7E)); ++i)	;
+			continue;
+		}
+		text[n++] = prompt[i];
+		if ('\n' == prompt[i])	{ pPrompt->last = n; }
+	}
+	text[n] = '\0';
+	pPrompt->text = text;
+	pPrompt->len = n + 1; // > 0 means text is allocated
+	pPrompt->cols = 0;
+	return 0;
+}
+
+// Cells of text with escape sequences skipped, wide chars are wrapped for cols.
+static int crossline_ansi_cells (const char *text, int len, int cols)
+{
+	int i = 0, run, cells = 0;
+
+	while (i < len) {
+		if ('\x1b' == text[i]) {
+			if ((i + 1 < len) && ('[' == text[i+1])) {
+				for (i += 2; (i < len) && ((text[i] < 0x40) || (text[i] > 0x7E)); ++i)	;
+			}
+			i++;
+			continue;
+		}
+		for (run = i; (run < len) && ('\x1b' != text[run]) && ('\r' != text[run]); ++run)	;
+		cells = crossline_cell_add (cells, &text[i], run - i, cols);
+		i = (run > i) ? run : run + 1;
+	}
+	return cells;
+}
+
+// Cells of last prompt line, parsed once for each columns.
+static int crossline_prompt_cells (crossline_prompt_t *pPrompt, int cols)
+{
+	if (pPrompt->cols != cols) {
+		pPrompt->cells = crossline_ansi_cells (&pPrompt->text[pPrompt->last], (int)strlen (&pPrompt->text[pPrompt->last]), cols);
+		pPrompt->cols = cols;
+	}
+	return pPrompt->cells;
+}
+
+// Screen rows of prompt lines before last line.
+static int crossline_prompt_rows (crossline_prompt_t *pPrompt, int cols)
+{
+	int rows = 0, beg, end, cells;
+
+	for (beg = 0; beg < pPrompt->last; beg = end + 1) {
+		for (end = beg; '\n' != pPrompt->text[end]; ++end)	;
+		cells = crossline_ansi_cells (&pPrompt->text[beg], end - beg, cols);
+		rows += (cells > 0) ? (cells - 1) / cols + 1 : 1;
+	}
+	return rows;
+}
+
+// Get dynamic prompt from callback and parse it.
+static int crossline_prompt_render (crossline_prompt_t *pPrompt)
+{
+	char text[CROSS_PROMPT_BUF_LEN];
+
+	pPrompt->dirty = 0;
+	text[0] = '\0';
+	pPrompt->func (text, sizeof(text), pPrompt->arg);
+	text[sizeof(text) - 1] = '\0';
+	return crossline_prompt_parse (pPrompt, text);
+}
+
+crossline_prompt_t* crossline_prompt_create (const char *prompt, crossline_prompt_callback pCbFunc, void *arg)
+{
+	crossline_prompt_t *pPrompt = (crossline_prompt_t*)calloc (1, sizeof(crossline_prompt_t));
+
+	if (NULL == pPrompt)	{ return NULL; }
+	pPrompt->func	= pCbFunc;
+	pPrompt->arg	= arg;
+	pPrompt->dirty	= (NULL != pCbFunc);
+	if (crossline_prompt_parse (pPrompt, (NULL != prompt) ? prompt : "") < 0) {
+		free (pPrompt);
+		return NULL;
 	}
+	return pPrompt;
+}
+
+void crossline_prompt_free (crossline_prompt_t *pPrompt)
+{
+	if (NULL != pPrompt) {
+		free (pPrompt->text);
+		free (pPrompt);
+	}
+}
+
+void crossline_prompt_dirty (crossline_prompt_t *pPrompt)
+{
+	if (NULL != pPrompt)	{ pPrompt->dirty = 1; }
+}
+
+// Append line to history and keep case folded copy for search.
+static void crossline_history_add (const char *line)
+{
+	int idx = s_history_id++ % CROSS_HISTORY_MAX_LINE, len = (int)strlen (line);
+	if (len > CROSS_HISTORY_BUF_LEN - 1)	{ len = CROSS_HISTORY_BUF_LEN - 1; }
+	memcpy (s_history_buf[idx], line, len);
+	s_history_buf[idx][len] = '\0';
+	crossline_str_fold (s_history_fold[idx], s_history_buf[idx]);
 }
 
 void crossline_history_show (void)
 {
-	crossline_history_dump (stdout, 1, NULL, 0, isatty(STDIN_FILENO));
+	crossline_history_dump (stdout, 1, NULL, 0, isatty(STDIN_FILENO) ? 2 : 0);
 }
 
 void  crossline_history_clear (void)
 {
 	memset (s_history_buf, 0, sizeof (s_history_buf));
+	memset (s_history_fold, 0, sizeof (s_history_fold));
 	s_history_id = 0;
 }
 
@@ -404,35 +1063,161 @@ int crossline_history_load (const char* filename)
 			{ buf[len-1] = '\0'; }
 		if (len > 0) {
 			buf[CROSS_HISTORY_BUF_LEN-1] = '\0';
-			strcpy (s_history_buf[(s_history_id++) % CROSS_HISTORY_MAX_LINE], buf);
+			crossline_history_add (buf);
 		}
 	}
 	fclose(file);
 	return 0;
 }
 
+// Enable/Disable history autosuggestion, return previous setting.
+int crossline_autosuggest_set (int enable)
+{
+	int prev = s_autosuggest;
+	s_autosuggest = enable;
+	return prev;
+}
+
+void crossline_autosuggest_color_set (crossline_color_e color)
+{
+	s_suggest_color = color;
+}
+
 // Register completion callback.
 void crossline_completion_register (crossline_completion_callback pCbFunc)
 {
 	s_completion_callback = pCbFunc;
+	s_cache_line = NULL;
 }
 
-// Add completion in callback. Word is must, help for word is optional.
-void  crossline_completion_add_color (crossline_completions_t *pCompletions, const char *word, 
+// Enable callback results cache with TTL in ms, 0 to disable, <0 never expires. Return previous TTL.
+int crossline_completion_cache_set (int ttl_ms)
+{
+	int prev = s_cache_ttl;
+	s_cache_ttl = ttl_ms;
+	s_cache_line = NULL;
+	return prev;
+}
+
+// Drop cached results, ex. data behind callback is changed.
+void crossline_completion_cache_clear (void)
+{
+	s_cache_line = NULL;
+}
+
+// Declare results in callback are prefix-monotonic, so longer last word can be answered by filtering them.
+void crossline_completion_monotonic_set (crossline_completions_t *pCompletions)
+{
+	if (NULL != pCompletions)	{ pCompletions->monotonic = 1; }
+}
+
+static char* crossline_arena_alloc (crossline_arena_t *arena, int len)
+{
+	crossline_arena_blk_t *blk = arena->cur;
+	char *ptr;
+
+	while ((NULL != blk) && (blk->used + len > blk->size)) {
+		if (NULL != (blk = blk->next))	{ blk->used = 0; }
+	}
+	if (NULL == blk) {
+		int size = (len > CROSS_COMPLET_ARENA_BLK) ? len : CROSS_COMPLET_ARENA_BLK;
+		blk = (crossline_arena_blk_t*)malloc (sizeof(crossline_arena_blk_t) + size);
+		if (NULL == blk)	{ return NULL; }
+		blk->size = size;
+		blk->used = 0;
+		if (NULL == arena->cur) {
+			blk->next = NULL;
+			arena->head = blk;
+		} else { // insert after current block to keep bigger blocks for reuse
+			blk->next = arena->cur->next;
+			arena->cur->next = blk;
+		}
+	}
+	arena->cur = blk;
+	ptr = &blk->data[blk->used];
+	blk->used += len;
+	return ptr;
+}
+
+static const char* crossline_arena_strdup (crossline_arena_t *arena, const char *str)
+{
+	int len = (int)strlen (str) + 1;
+	char *ptr = crossline_arena_alloc (arena, len);
+	if (NULL != ptr)	{ memcpy (ptr, str, len); }
+	return ptr;
+}
+
+static void crossline_arena_reset (crossline_arena_t *arena)
+{
+	arena->cur = arena->head;
+	if (NULL != arena->cur)	{ arena->cur->used = 0; }
+}
+
+static void crossline_arena_free (crossline_arena_t *arena)
+{
+	crossline_arena_blk_t *blk;
+	while (NULL != (blk = arena->head)) {
+		arena->head = blk->next;
+		free (blk);
+	}
+	arena->cur = NULL;
+}
+
+static void crossline_completions_reset (crossline_completions_t *pCompletions)
+{
+	pCompletions->num = 0;
+	pCompletions->common_len = -1;
+	pCompletions->monotonic = 0;
+	pCompletions->hints = "";
+	pCompletions->color_hints = CROSSLINE_COLOR_DEFAULT;
+	crossline_arena_reset (&pCompletions->arena);
+}
+
+// Add completion without copying, word and help must be valid until completion is done.
+void crossline_completion_add_static_color (crossline_completions_t *pCompletions, const char *word, 
 											crossline_color_e wcolor, const char *help, crossline_color_e hcolor)
 {
-	if ((NULL != pCompletions) && (NULL != word) && (pCompletions->num < CROSS_COMPLET_MAX_LINE)) {
-		strncpy (pCompletions->word[pCompletions->num], word, CROSS_COMPLET_WORD_LEN);
-		pCompletions->word[pCompletions->num][CROSS_COMPLET_WORD_LEN - 1] = '\0';
-		pCompletions->color_word[pCompletions->num] = wcolor;
-		pCompletions->help[pCompletions->num][0] = '\0';
-		if (NULL != help) {
-			strncpy (pCompletions->help[pCompletions->num], help, CROSS_COMPLET_HELP_LEN);
-			pCompletions->help[pCompletions->num][CROSS_COMPLET_HELP_LEN - 1] = '\0';
-			pCompletions->color_help[pCompletions->num] = hcolor;
+	crossline_completion_item_t *items;
+
+	if ((NULL == pCompletions) || (NULL == word))	{ return; }
+	if (NULL != pCompletions->lock)	{ crossline_mutex_lock (pCompletions->lock); }
+	if (pCompletions->num >= pCompletions->max) {
+		int max = pCompletions->max ? pCompletions->max * 2 : 256;
+		items = (crossline_completion_item_t*)realloc (pCompletions->items, sizeof(*items) * max);
+		if (NULL != items) {
+			pCompletions->items = items;
+			pCompletions->max = max;
 		}
-		pCompletions->num++;
 	}
+	// words over provider cap are dropped
+	if ((pCompletions->num < pCompletions->max) && ((pCompletions->limit <= 0) || (pCompletions->num < pCompletions->limit))) {
+		pCompletions->common_len = -1;
+		items = &pCompletions->items[pCompletions->num++];
+		items->word = word;
+		items->help = (NULL != help) ? help : "";
+		items->color_word = wcolor;
+		items->color_help = (NULL != help) ? hcolor : CROSSLINE_COLOR_DEFAULT;
+	}
+	if (NULL != pCompletions->lock)	{ crossline_mutex_unlock (pCompletions->lock); }
+}
+void crossline_completion_add_static (crossline_completions_t *pCompletions, const char *word, const char *help)
+{
+	crossline_completion_add_static_color (pCompletions, word, CROSSLINE_COLOR_DEFAULT, help, CROSSLINE_COLOR_DEFAULT);
+}
+
+// Add completion in callback. Word is must, help for word is optional.
+void  crossline_completion_add_color (crossline_completions_t *pCompletions, const char *word, 
+											crossline_color_e wcolor, const char *help, crossline_color_e hcolor)
+{
+	const char *help_copy = NULL;
+
+	if ((NULL == pCompletions) || (NULL == word))	{ return; }
+	if (NULL != pCompletions->lock)	{ crossline_mutex_lock (pCompletions->lock); }
+	word = crossline_arena_strdup (&pCompletions->arena, word);
+	if ((NULL != help) && (NULL != word))	{ help_copy = crossline_arena_strdup (&pCompletions->arena, help); }
+	if (NULL != pCompletions->lock)	{ crossline_mutex_unlock (pCompletions->lock); }
+	if ((NULL != word) && ((NULL == help) || (NULL != help_copy)))
+		{ crossline_completion_add_static_color (pCompletions, word, wcolor, help_copy, hcolor); }
 }
 void crossline_completion_add (crossline_completions_t *pCompletions, const char *word, const char *help)
 {
@@ -443,9 +1228,12 @@ void crossline_completion_add (crossline_completions_t *pCompletions, const char
 void  crossline_hints_set_color (crossline_completions_t *pCompletions, const char *hints, crossline_color_e color)
 {
 	if ((NULL != pCompletions) && (NULL != hints)) {
-		strncpy (pCompletions->hints, hints, CROSS_COMPLET_HINT_LEN - 1);
-		pCompletions->hints[CROSS_COMPLET_HINT_LEN - 1] = '\0';
-		pCompletions->color_hints = color;
+		if (NULL != pCompletions->lock)	{ crossline_mutex_lock (pCompletions->lock); }
+		if (NULL != (hints = crossline_arena_strdup (&pCompletions->arena, hints))) {
+			pCompletions->hints = hints;
+			pCompletions->color_hints = color;
+		}
+		if (NULL != pCompletions->lock)	{ crossline_mutex_unlock (pCompletions->lock); }
 	}
 }
 void crossline_hints_set (crossline_completions_t *pCompletions, const char *hints)
@@ -453,62 +1241,2250 @@ void crossline_hints_set (crossline_completions_t *pCompletions, const char *hin
 	crossline_hints_set_color (pCompletions, hints, CROSSLINE_COLOR_DEFAULT);
 }
 
-/*****************************************************************************/
-
-int crossline_paging_set (int enable)
+/* Look up callback results cache. Same line reuses cached results, and if results are prefix-monotonic,
+ * longer last word (no new space) filters cached superset instead of calling back. Return 1 if hit.
+ */
+static int crossline_cache_lookup (const char *buf, crossline_completions_t *pCompletions)
 {
-	int prev = s_paging_print_line >=0;
-	s_paging_print_line = enable ? 0 : -1;
-	return prev;
+	crossline_completions_t *pCache = &s_completion_cache;
+	crossline_completion_item_t *item;
+	int i, len = (int)strlen (buf), cache_len, word;
+
+	if ((NULL == s_cache_line) || ((s_cache_ttl > 0) && (crossline_time_ms () - s_cache_time >= (uint64_t)s_cache_ttl)))
+		{ return 0; }
+	cache_len = (int)strlen (s_cache_line);
+	if ((len == cache_len) && !strcmp (buf, s_cache_line))
+		{ word = len; }
+	else if (pCache->monotonic && (len > cache_len) && !strncmp (buf, s_cache_line, cache_len) && 
+			(NULL == strchr (&buf[cache_len], ' ')))
+		{ for (word = len; (word > 0) && (' ' != buf[word-1]); --word) ; }
+	else
+		{ return 0; }
+	for (i = 0; i < pCache->num; ++i) {
+		item = &pCache->items[i];
+		if (!strncasecmp (item->word, &buf[word], len - word)) {
+			crossline_completion_add_static_color (pCompletions, item->word, item->color_word, 
+													item->help[0] ? item->help : NULL, item->color_help);
+		}
+	}
+	pCompletions->hints			= pCache->hints;
+	pCompletions->color_hints	= pCache->color_hints;
+	pCompletions->monotonic		= pCache->monotonic;
+	return 1;
 }
 
-int crossline_paging_check (int line_len)
+static void crossline_cache_store (const char *buf, crossline_completions_t *pCompletions)
 {
-	char *paging_hints = "*** Press <Space> or <Enter> to continue . . .";
-	int	i, ch, rows, cols, len = (int)strlen(paging_hints);
+	crossline_completions_t *pCache = &s_completion_cache;
+	crossline_completion_item_t *item;
+	int i;
 
-	if ((s_paging_print_line < 0) || !isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))	{ return 0; }
-	crossline_screen_get (&rows, &cols);
-	s_paging_print_line += (line_len + cols - 1) / cols;
-	if (s_paging_print_line >= (rows - 1)) {
-		printf ("%s", paging_hints);
-		ch = crossline_getch();
-		if (0 == ch) { crossline_getch(); }	// some terminal server may send 0 after Enter
-		// clear paging hints
-		for (i = 0; i < len; ++i) { printf ("\b"); }
-		for (i = 0; i < len; ++i) { printf (" ");  }
-		for (i = 0; i < len; ++i) { printf ("\b"); }
-		s_paging_print_line = 0;
-		if ((' ' != ch) && (KEY_ENTER != ch) && (KEY_ENTER2 != ch)) {
-			return 1; 
-		}
+	if (0 == s_cache_ttl)	{ return; }
+	crossline_completions_reset (pCache);
+	for (i = 0; i < pCompletions->num; ++i) {
+		item = &pCompletions->items[i];
+		crossline_completion_add_color (pCache, item->word, item->color_word, item->help[0] ? item->help : NULL, item->color_help);
 	}
-	return 0;
+	crossline_hints_set_color (pCache, pCompletions->hints, pCompletions->color_hints);
+	pCache->monotonic	= pCompletions->monotonic;
+	s_cache_line		= crossline_arena_strdup (&pCache->arena, buf);
+	s_cache_time		= crossline_time_ms ();
+	if (pCache->num != pCompletions->num)	{ s_cache_line = NULL; } // no memory
 }
 
 /*****************************************************************************/
 
-void  crossline_prompt_color_set (crossline_color_e color)
+/* Completion providers are run in parallel by a small thread pool, the caller thread also runs tasks
+ * of its own batch while waiting. Results are merged by priority and provider order, and duplicated
+ * words are dropped with hash set. Each provider's results are capped by its max_num.
+ */
+
+typedef struct crossline_provider_t {
+	crossline_completion_callback	callback;
+	int		priority, max_num;
+} crossline_provider_t;
+
+typedef struct crossline_batch_t {
+	struct crossline_batch_t	*next;
+	const char				*buf;
+	crossline_provider_t	*providers;
+	crossline_completions_t	*results;
+	int		num, taken, finished;
+} crossline_batch_t;
+
+static crossline_provider_t s_providers[CROSS_COMPLET_PROVIDER_MAX]; // Sorted by priority
+static int		s_provider_num		= 0;
+static int		s_pool_threads		= 0;
+static crossline_mutex_t	s_pool_lock;
+static crossline_cond_t		s_pool_cond;
+static crossline_batch_t	*s_pool_batches = NULL; // Batches with tasks not taken
+
+// Take one task from batches (only from batch if not NULL) and run it, pool lock must be held. Return 0 if no task.
+static int crossline_pool_run_one (crossline_batch_t *only)
 {
-	s_prompt_color	= color;
+	crossline_batch_t **link, *batch;
+	int id;
+
+	for (link = &s_pool_batches; NULL != (batch = *link); link = &batch->next) {
+		if ((NULL == only) || (batch == only))	{ break; }
+	}
+	if (NULL == batch)	{ return 0; }
+	id = batch->taken++;
+	if (batch->taken >= batch->num)	{ *link = batch->next; }
+	crossline_mutex_unlock (&s_pool_lock);
+	batch->providers[id].callback (batch->buf, &batch->results[id]);
+	crossline_mutex_lock (&s_pool_lock);
+	batch->finished++;
+	crossline_cond_broadcast (&s_pool_cond);
+	return 1;
 }
 
-void crossline_screen_clear ()
+#ifdef _WIN32
+static DWORD WINAPI crossline_pool_worker (LPVOID arg)
+#else
+static void* crossline_pool_worker (void *arg)
+#endif
 {
-	int ret = system (s_crossline_win ? "cls" : "clear");
-	(void) ret;
+	(void)arg;
+	crossline_mutex_lock (&s_pool_lock);
+	for (;;) {
+		if (!crossline_pool_run_one (NULL))
+			{ crossline_cond_wait (&s_pool_cond, &s_pool_lock); }
+	}
+	return 0;
 }
 
-#ifdef _WIN32	// Windows
-
-int crossline_getch (void)
+// Start thread pool in main thread when first provider is added.
+static void crossline_pool_start (void)
 {
-	fflush (stdout);
-	return _getch();
+	int i;
+#ifdef _WIN32
+	HANDLE thread;
+#else
+	pthread_t thread;
+#endif
+	if (s_pool_threads > 0)	{ return; }
+	crossline_path_lock_init ();
+	crossline_mutex_init (&s_pool_lock);
+	crossline_cond_init (&s_pool_cond);
+	for (i = 0; i < CROSS_COMPLET_THREADS; ++i) {
+#ifdef _WIN32
+		if (NULL == (thread = CreateThread (NULL, 0, crossline_pool_worker, NULL, 0, NULL)))	{ break; }
+		CloseHandle (thread);
+#else
+		if (0 != pthread_create (&thread, NULL, crossline_pool_worker, NULL))	{ break; }
+		pthread_detach (thread);
+#endif
+		s_pool_threads++;
+	}
 }
-void crossline_screen_get (int *pRows, int *pCols)
+
+// Add completion provider, higher priority is ranked first, max_num caps its results (0 is unlimited).
+int crossline_completion_provider_add (crossline_completion_callback pCbFunc, int priority, int max_num)
 {
-	CONSOLE_SCREEN_BUFFER_INFO inf;
+	int i;
+	if ((NULL == pCbFunc) || (s_provider_num >= CROSS_COMPLET_PROVIDER_MAX))	{ return -1; }
+	crossline_pool_start ();
+	for (i = s_provider_num; (i > 0) && (s_providers[i-1].priority < priority); --i)
+		{ s_providers[i] = s_providers[i-1]; }
+	s_providers[i].callback	= pCbFunc;
+	s_providers[i].priority	= priority;
+	s_providers[i].max_num	= max_num;
+	s_provider_num++;
+	s_cache_line = NULL;
+	return 0;
+}
+
+// Remove completion provider.
+void crossline_completion_provider_remove (crossline_completion_callback pCbFunc)
+{
+	int i, j;
+	for (i = j = 0; i < s_provider_num; ++i) {
+		if (s_providers[i].callback != pCbFunc)	{ s_providers[j++] = s_providers[i]; }
+	}
+	s_provider_num = j;
+	s_cache_line = NULL;
+}
+
+static uint32_t crossline_hash (const char *str)
+{
+	uint32_t hash = 2166136261u; // FNV-1a
+	for (; '\0' != *str; ++str)	{ hash = (hash ^ (uint8_t)*str) * 16777619u; }
+	return hash;
+}
+
+// Run all providers and registered callback (priority 0) in parallel, then merge results.
+static void crossline_providers_complete (const char *buf, crossline_completions_t *pCompletions)
+{
+	crossline_provider_t	providers[CROSS_COMPLET_PROVIDER_MAX + 1];
+	crossline_completions_t	results[CROSS_COMPLET_PROVIDER_MAX + 1];
+	crossline_completion_item_t *item;
+	crossline_batch_t batch, **link;
+	const char **table;
+	int i, j, num = 0, total = 0, monotonic = 1;
+	uint32_t size, h;
+
+	for (i = 0; i < s_provider_num; ++i) {
+		if ((NULL != s_completion_callback) && (i == num) && (s_providers[i].priority < 0)) {
+			providers[num].callback = s_completion_callback;
+			providers[num++].max_num = 0;
+		}
+		providers[num++] = s_providers[i];
+	}
+	if ((NULL != s_completion_callback) && (num == s_provider_num)) {
+		providers[num].callback = s_completion_callback;
+		providers[num++].max_num = 0;
+	}
+	memset (results, 0, sizeof(results));
+	for (i = 0; i < num; ++i) {
+		crossline_completions_reset (&results[i]);
+		results[i].limit	= providers[i].max_num;
+		results[i].parent	= pCompletions;
+	}
+
+	memset (&batch, 0, sizeof(batch));
+	batch.buf		= buf;
+	batch.providers	= providers;
+	batch.results	= results;
+	batch.num		= num;
+	if ((num > 1) && (s_pool_threads > 0)) {
+		crossline_mutex_lock (&s_pool_lock);
+		for (link = &s_pool_batches; NULL != *link; link = &(*link)->next)	;
+		*link = &batch;
+		crossline_cond_broadcast (&s_pool_cond);
+		while (batch.finished < num) {
+			if (!crossline_pool_run_one (&batch))
+				{ crossline_cond_wait (&s_pool_cond, &s_pool_lock); }
+		}
+		crossline_mutex_unlock (&s_pool_lock);
+	} else {
+		for (i = 0; i < num; ++i)	{ providers[i].callback (buf, &results[i]); }
+	}
+
+	// Merge results by rank and drop duplicated words
+	for (i = 0; i < num; ++i)	{ total += results[i].num; }
+	for (size = 16; size < (uint32_t)total * 2; size *= 2)	;
+	table = (const char**)calloc (size, sizeof(const char*));
+	for (i = 0; i < num; ++i) {
+		for (j = 0; j < results[i].num; ++j) {
+			item = &results[i].items[j];
+			if (NULL != table) {
+				for (h = crossline_hash (item->word) & (size-1); (NULL != table[h]) && strcmp (table[h], item->word); h = (h+1) & (size-1))	;
+				if (NULL != table[h])	{ continue; }
+				table[h] = item->word;
+			}
+			crossline_completion_add_color (pCompletions, item->word, item->color_word, item->help[0] ? item->help : NULL, item->color_help);
+		}
+		if (('\0' == pCompletions->hints[0]) && ('\0' != results[i].hints[0]))
+			{ crossline_hints_set_color (pCompletions, results[i].hints, results[i].color_hints); }
+		monotonic = monotonic && results[i].monotonic;
+	}
+	pCompletions->monotonic = monotonic && (num > 0);
+	free (table);
+	for (i = 0; i < num; ++i) {
+		crossline_arena_free (&results[i].arena);
+		free (results[i].items);
+	}
+}
+
+// Return callback to run for completion, providers are run in one combined callback.
+static crossline_completion_callback crossline_completion_source (void)
+{
+	return (s_provider_num > 0) ? crossline_providers_complete : s_completion_callback;
+}
+
+// Call completion callback through cache and measure latency.
+static void crossline_completion_call (const char *buf, crossline_completions_t *pCompletions)
+{
+	uint64_t start;
+	if (crossline_cache_lookup (buf, pCompletions))	{ return; }
+	start = crossline_time_ms ();
+	crossline_completion_source () (buf, pCompletions);
+	s_completion_latency = (int)(crossline_time_ms () - start);
+	crossline_cache_store (buf, pCompletions);
+}
+
+// Return latency in ms of last completion callback (sync or async), -1 if none.
+int crossline_completion_latency (void)
+{
+	return s_completion_latency;
+}
+
+// Return 1 if async request is cancelled (line changed or deadline passed), callback can stop early.
+int crossline_completion_cancelled (crossline_completions_t *pCompletions)
+{
+	int cancelled = 0;
+	for (; (NULL != pCompletions) && !cancelled; pCompletions = pCompletions->parent) {
+		if (NULL != pCompletions->lock) {
+			crossline_mutex_lock (pCompletions->lock);
+			cancelled = pCompletions->cancelled;
+			crossline_mutex_unlock (pCompletions->lock);
+		}
+	}
+	return cancelled;
+}
+
+/* Async completion runs callback in a new worker thread with its own completions.
+ * Job is shared by editor and worker and freed by the last one, so cancelled callback can finish in background.
+ */
+typedef struct crossline_async_job_t {
+	crossline_mutex_t		lock;
+	crossline_completions_t	completions;
+	crossline_completion_callback	callback;
+	int			refs, done, key, latency;
+	uint64_t	start;
+	char		line[1];
+} crossline_async_job_t;
+
+// Enable/Disable async completion, deadline_ms > 0 applies partial results when callback is too slow. Return previous.
+int crossline_completion_async_set (int enable, int deadline_ms)
+{
+	int prev = s_async_on;
+	s_async_on = enable;
+	s_async_deadline = deadline_ms;
+	return prev;
+}
+
+static void crossline_async_release (crossline_async_job_t *job)
+{
+	int refs;
+	crossline_mutex_lock (&job->lock);
+	refs = --job->refs;
+	job->completions.cancelled = 1;
+	crossline_mutex_unlock (&job->lock);
+	if (refs > 0)	{ return; }
+	crossline_mutex_destroy (&job->lock);
+	crossline_arena_free (&job->completions.arena);
+	free (job->completions.items);
+	free (job);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI crossline_async_worker (LPVOID arg)
+#else
+static void* crossline_async_worker (void *arg)
+#endif
+{
+	crossline_async_job_t *job = (crossline_async_job_t*)arg;
+	job->callback (job->line, &job->completions);
+	crossline_mutex_lock (&job->lock);
+	job->done = 1;
+	job->latency = (int)(crossline_time_ms () - job->start);
+	crossline_mutex_unlock (&job->lock);
+	crossline_async_release (job);
+	return 0;
+}
+
+// Cancel running async completion.
+static void crossline_async_cancel (void)
+{
+	if (NULL != s_async_job) {
+		crossline_async_release (s_async_job);
+		s_async_job = NULL;
+	}
+}
+
+// Check async job is finished or deadline passed.
+static int crossline_async_ready (crossline_async_job_t *job)
+{
+	int done;
+	crossline_mutex_lock (&job->lock);
+	done = job->done;
+	crossline_mutex_unlock (&job->lock);
+	return done || ((s_async_deadline > 0) && (crossline_time_ms () - job->start >= (uint64_t)s_async_deadline));
+}
+
+/* Get callback results in async mode. Return 0 if results are added, 1 if request is running.
+ * Running request for other line is cancelled, and new request is started for buf.
+ */
+static int crossline_async_complete (const char *buf, crossline_completions_t *pCompletions, int key)
+{
+	crossline_async_job_t *job = s_async_job;
+	crossline_completions_t *pResults;
+	crossline_completion_item_t *item;
+	int i, ret = 0, len = (int)strlen (buf);
+#ifdef _WIN32
+	HANDLE thread;
+#else
+	pthread_t thread;
+#endif
+
+	if ((NULL != job) && !strcmp (job->line, buf)) {
+		if (!crossline_async_ready (job))	{ return 1; }
+		pResults = &job->completions;
+		crossline_mutex_lock (&job->lock);
+		for (i = 0; i < pResults->num; ++i) {
+			item = &pResults->items[i];
+			crossline_completion_add_color (pCompletions, item->word, item->color_word, item->help[0] ? item->help : NULL, item->color_help);
+		}
+		crossline_hints_set_color (pCompletions, pResults->hints, pResults->color_hints);
+		pCompletions->monotonic = pResults->monotonic;
+		if (job->done)	{ s_completion_latency = job->latency; } // partial results are not cached
+		crossline_mutex_unlock (&job->lock);
+		if (job->done)	{ crossline_cache_store (buf, pCompletions); }
+		crossline_async_cancel ();
+		return 0;
+	}
+	crossline_async_cancel ();
+	if (crossline_cache_lookup (buf, pCompletions))	{ return 0; }
+
+	crossline_path_lock_init ();
+	job = (crossline_async_job_t*)calloc (1, sizeof(crossline_async_job_t) + len);
+	if (NULL != job) {
+		memcpy (job->line, buf, len + 1);
+		crossline_mutex_init (&job->lock);
+		crossline_completions_reset (&job->completions);
+		job->completions.lock = &job->lock;
+		job->callback	= crossline_completion_source ();
+		job->key		= key;
+		job->refs		= 2;
+		job->start		= crossline_time_ms ();
+#ifdef _WIN32
+		thread = CreateThread (NULL, 0, crossline_async_worker, job, 0, NULL);
+		ret = (NULL != thread);
+		if (ret)	{ CloseHandle (thread); }
+#else
+		ret = (0 == pthread_create (&thread, NULL, crossline_async_worker, job));
+		if (ret)	{ pthread_detach (thread); }
+#endif
+		if (!ret) {
+			job->refs = 1;
+			crossline_async_release (job);
+		} else
+			{ s_async_job = job; }
+	}
+	if (!ret)	{ crossline_completion_call (buf, pCompletions); } // fall back to sync call
+	return ret;
+}
+
+/*****************************************************************************/
+
+// Grow array to hold num items, return 0 if OK.
+static int crossline_array_grow (void **pArray, uint32_t *pMax, uint32_t num, uint32_t item_size)
+{
+	uint32_t max = *pMax;
+	void *array;
+	if (num <= max)	{ return 0; }
+	for (max = max ? max : 16; max < num; )	{ max *= 2; }
+	if (NULL == (array = realloc (*pArray, (size_t)max * item_size)))	{ return -1; }
+	*pArray = array;
+	*pMax = max;
+	return 0;
+}
+
+// Map whole file read only and shared, return NULL if fail.
+static void* crossline_file_map (const char *filename, size_t *pSize)
+{
+	void *addr = NULL;
+#ifdef _WIN32
+	HANDLE hFile, hMap;
+	LARGE_INTEGER size;
+	hFile = CreateFileA (filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)	{ return NULL; }
+	if (GetFileSizeEx (hFile, &size) && (size.QuadPart > 0)) {
+		hMap = CreateFileMappingA (hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (NULL != hMap) {
+			addr = MapViewOfFile (hMap, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle (hMap);
+			*pSize = (size_t)size.QuadPart;
+		}
+	}
+	CloseHandle (hFile);
+#else
+	struct stat st;
+	int fd = open (filename, O_RDONLY);
+	if (fd < 0)	{ return NULL; }
+	if ((0 == fstat (fd, &st)) && (st.st_size > 0)) {
+		addr = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		addr = (MAP_FAILED == addr) ? NULL : addr;
+		*pSize = st.st_size;
+	}
+	close (fd);
+#endif
+	return addr;
+}
+
+static void crossline_file_unmap (void *addr, size_t size)
+{
+#ifdef _WIN32
+	(void)size;
+	UnmapViewOfFile (addr);
+#else
+	munmap (addr, size);
+#endif
+}
+
+/*****************************************************************************/
+
+/* Path completion lists directory of last token and completes file name.
+ * Sorted directory listings are cached and keyed by (dev, inode, mtime) (path and mtime in Windows),
+ * so repeated TAB only stats the directory. Linux reads entries with getdents64 and uses d_type,
+ * symbolic links and unknown types are stat-ed only when they're matched.
+ */
+
+typedef struct crossline_dir_cache_t {
+	char		*path;		// Directory path (Windows key)
+	uint64_t	dev, ino, mtime;
+	char		*pool;		// Type byte + name + '\0' of each entry
+	char		**names;	// Sorted names in pool, type byte is before name
+	uint32_t	num;
+	uint64_t	used;		// LRU tick
+} crossline_dir_cache_t;
+
+static crossline_dir_cache_t s_dir_cache[CROSS_PATH_CACHE_NUM];
+static uint64_t		s_dir_tick = 0;
+static crossline_mutex_t	s_path_lock;
+static int			s_path_lock_on = 0;
+
+// Init path cache lock in main thread before completion runs in worker threads.
+static void crossline_path_lock_init (void)
+{
+	if (s_path_lock_on)	{ return; }
+	crossline_mutex_init (&s_path_lock);
+	s_path_lock_on = 1;
+}
+
+#ifdef _WIN32
+	#define CROSS_PATH_SEP(ch)		(('/' == (ch)) || ('\\' == (ch)))
+	#define crossline_name_cmp		_stricmp
+	#define crossline_name_ncmp		_strnicmp
+	#define CROSS_PATH_ESCAPE		""	// backslash is path separator
+#else
+	#define CROSS_PATH_SEP(ch)		('/' == (ch))
+	#define crossline_name_cmp		strcmp
+	#define crossline_name_ncmp		strncmp
+	#define CROSS_PATH_ESCAPE		" \t\\\"'()&;|<>$`!*?[]{}#"
+#endif
+
+static int crossline_name_sort (const void *a, const void *b)
+{
+	return crossline_name_cmp (*(char* const*)a, *(char* const*)b);
+}
+
+// Append type byte and name to listing pool, return 0 if OK.
+static int crossline_dir_add (char **pPool, uint32_t *pLen, uint32_t *pMax, uint32_t *pNum, const char *name, char type)
+{
+	uint32_t len = (uint32_t)strlen (name);
+	if (('.' == name[0]) && (('\0' == name[1]) || (('.' == name[1]) && ('\0' == name[2]))))	{ return 0; }
+	if (crossline_array_grow ((void**)pPool, pMax, *pLen + len + 2, 1) < 0)	{ return -1; }
+	(*pPool)[(*pLen)++] = type;
+	memcpy (&(*pPool)[*pLen], name, len + 1);
+	*pLen += len + 1;
+	(*pNum)++;
+	return 0;
+}
+
+/* Read directory entries to pool, return 0 if OK. Type byte is 'd' for directory, 'f' for others,
+ * '?' means unknown or symbolic link and should be checked by stat.
+ */
+static int crossline_dir_read (const char *dir, char **pPool, uint32_t *pNum)
+{
+	uint32_t len = 0, max = 0;
+	int ret = 0;
+#ifdef _WIN32
+	char pattern[MAX_PATH + 4];
+	WIN32_FIND_DATAA data;
+	HANDLE hFind;
+
+	snprintf (pattern, sizeof(pattern), "%s\\*", dir);
+	if (INVALID_HANDLE_VALUE == (hFind = FindFirstFileA (pattern, &data)))	{ return -1; }
+	do {
+		ret = crossline_dir_add (pPool, &len, &max, pNum, data.cFileName, (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? 'd' : 'f');
+	} while ((0 == ret) && FindNextFileA (hFind, &data));
+	FindClose (hFind);
+#elif defined(__linux__)
+	struct crossline_dirent64 {
+		uint64_t		d_ino;
+		int64_t			d_off;
+		unsigned short	d_reclen;
+		unsigned char	d_type;
+		char			d_name[1];
+	} *ent;
+	char	buf[65536];
+	long	n, off;
+	int		fd = open (dir, O_RDONLY | O_DIRECTORY);
+
+	if (fd < 0)	{ return -1; }
+	while ((0 == ret) && ((n = syscall (SYS_getdents64, fd, buf, sizeof(buf))) > 0)) {
+		for (off = 0; (0 == ret) && (off < n); off += ent->d_reclen) {
+			ent = (struct crossline_dirent64*)&buf[off];
+			ret = crossline_dir_add (pPool, &len, &max, pNum, ent->d_name, 
+						(DT_DIR == ent->d_type) ? 'd' : (((DT_LNK == ent->d_type) || (DT_UNKNOWN == ent->d_type)) ? '?' : 'f'));
+		}
+	}
+	close (fd);
+#else
+	struct dirent *ent;
+	DIR *pDir = opendir (dir);
+
+	if (NULL == pDir)	{ return -1; }
+	while ((0 == ret) && (NULL != (ent = readdir (pDir))))
+		{ ret = crossline_dir_add (pPool, &len, &max, pNum, ent->d_name, '?'); }
+	closedir (pDir);
+#endif
+	if ((0 == ret) && (0 == max))	{ ret = crossline_array_grow ((void**)pPool, &max, 1, 1); } // empty directory
+	return ret;
+}
+
+// Get sorted listing of dir from cache or read it, path lock must be held. Return NULL if fail.
+static crossline_dir_cache_t* crossline_dir_get (const char *dir)
+{
+	crossline_dir_cache_t *pCache, *pFree = &s_dir_cache[0];
+	uint64_t dev = 0, ino = 0, mtime;
+	char	*pool = NULL, *p, **names;
+	uint32_t num = 0, i;
+	int		k;
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	if (!GetFileAttributesExA (dir, GetFileExInfoStandard, &attr) || !(attr.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		{ return NULL; }
+	mtime = ((uint64_t)attr.ftLastWriteTime.dwHighDateTime << 32) | attr.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat st;
+	if ((0 != stat (dir, &st)) || !S_ISDIR (st.st_mode))	{ return NULL; }
+	dev	= (uint64_t)st.st_dev;
+	ino	= (uint64_t)st.st_ino;
+  #ifdef __linux__
+	mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  #else
+	mtime = (uint64_t)st.st_mtime;
+  #endif
+#endif
+	for (k = 0; k < CROSS_PATH_CACHE_NUM; ++k) {
+		pCache = &s_dir_cache[k];
+		if ((NULL != pCache->names) && (pCache->dev == dev) && (pCache->ino == ino) && (pCache->mtime == mtime)
+#ifdef _WIN32
+			&& !_stricmp (pCache->path, dir)
+#endif
+			) {
+			pCache->used = ++s_dir_tick;
+			return pCache;
+		}
+		if (pCache->used < pFree->used)	{ pFree = pCache; }
+	}
+
+	if (crossline_dir_read (dir, &pool, &num) < 0)	{ free (pool); return NULL; }
+	if (NULL == (names = (char**)malloc ((num + 1) * sizeof(char*))))	{ free (pool); return NULL; }
+	for (p = pool, i = 0; i < num; ++i, p += strlen (p) + 1)	{ names[i] = ++p; }
+	qsort (names, num, sizeof(char*), crossline_name_sort);
+	free (pFree->path);
+	free (pFree->pool);
+	free (pFree->names);
+	pFree->path		= (char*)malloc (strlen (dir) + 1);
+	if (NULL != pFree->path)	{ strcpy (pFree->path, dir); }
+	pFree->dev		= dev;
+	pFree->ino		= ino;
+	pFree->mtime	= mtime;
+	pFree->pool		= pool;
+	pFree->names	= names;
+	pFree->num		= num;
+	pFree->used		= ++s_dir_tick;
+	return pFree;
+}
+
+// Add name to completions, escape special characters if not in quotes, directory is ended with separator.
+static void crossline_path_add (crossline_completions_t *pCompletions, const char *name, int is_dir, int quoted)
+{
+	char word[CROSS_HISTORY_BUF_LEN];
+	int len = 0;
+
+	for (; ('\0' != *name) && (len < (int)sizeof(word) - 3); ++name) {
+		if (!quoted && ('\0' != CROSS_PATH_ESCAPE[0]) && (NULL != strchr (CROSS_PATH_ESCAPE, *name)))	{ word[len++] = '\\'; }
+		word[len++] = *name;
+	}
+	if (is_dir)	{ word[len++] = '/'; }
+	word[len] = '\0';
+	crossline_completion_add_color (pCompletions, word, is_dir ? (CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_BLUE) : CROSSLINE_COLOR_DEFAULT, 
+									NULL, CROSSLINE_COLOR_DEFAULT);
+}
+
+/* Complete file name of last token in buf, can be registered as completion callback or provider.
+ * Token can be quoted with "" or '' and special characters can be escaped by '\' (not in Windows),
+ * leading ~/ is home directory. Hidden files are listed only when name starts with '.'.
+ */
+void crossline_completion_path (const char *buf, crossline_completions_t *pCompletions)
+{
+	char	path[CROSS_HISTORY_BUF_LEN], dir[CROSS_HISTORY_BUF_LEN + 256];
+#ifndef _WIN32
+	char	full[CROSS_HISTORY_BUF_LEN + 512];
+#endif
+	const char	*base, *home, *name;
+	int		i, start = 0, quote = 0, len = 0, base_len, lo, hi, mid, is_dir;
+	crossline_dir_cache_t *pCache;
+#ifndef _WIN32
+	struct stat st;
+#endif
+
+	if ((NULL == buf) || (NULL == pCompletions))	{ return; }
+	// find last token start with quote state
+	for (i = 0; '\0' != buf[i]; ++i) {
+		if (quote) {
+			if (buf[i] == quote)	{ quote = 0; }
+		} else if (('\\' == buf[i]) && ('\0' != CROSS_PATH_ESCAPE[0]) && ('\0' != buf[i+1])) {
+			i++;
+		} else if (('"' == buf[i]) || ('\'' == buf[i])) {
+			quote = buf[i];
+		} else if (' ' == buf[i])
+			{ start = i + 1; }
+	}
+	// unquote and unescape token
+	for (i = start, quote = 0; ('\0' != buf[i]) && (len < (int)sizeof(path) - 1); ++i) {
+		if (quote && (buf[i] == quote))	{ quote = 0; continue; }
+		if (!quote && (('"' == buf[i]) || ('\'' == buf[i])))	{ quote = buf[i]; continue; }
+		if (!quote && ('\\' == buf[i]) && ('\0' != CROSS_PATH_ESCAPE[0]) && ('\0' != buf[i+1]))	{ i++; }
+		path[len++] = buf[i];
+	}
+	path[len] = '\0';
+	for (base = path + len; (base > path) && !CROSS_PATH_SEP(base[-1]); --base)	;
+	base_len = (int)strlen (base);
+	if (base == path) {
+		strcpy (dir, ".");
+	} else if (('~' == path[0]) && CROSS_PATH_SEP(path[1]) && (NULL != (home = getenv ("HOME")))) {
+		snprintf (dir, sizeof(dir), "%s%.*s", home, (int)(base - path - 1), path + 1);
+	} else
+		{ snprintf (dir, sizeof(dir), "%.*s", (base - path > 1) ? (int)(base - path - 1) : 1, path); }
+
+	if (s_path_lock_on)	{ crossline_mutex_lock (&s_path_lock); }
+	if (NULL != (pCache = crossline_dir_get (dir))) {
+		// binary search first name not less than base
+		for (lo = 0, hi = (int)pCache->num; lo < hi; ) {
+			mid = (lo + hi) / 2;
+			if (crossline_name_ncmp (pCache->names[mid], base, base_len) < 0)	{ lo = mid + 1; }
+			else	{ hi = mid; }
+		}
+		for (; (lo < (int)pCache->num) && !crossline_name_ncmp (pCache->names[lo], base, base_len); ++lo) {
+			if (crossline_completion_cancelled (pCompletions))	{ break; }
+			name = pCache->names[lo];
+			if (('.' == name[0]) && ('.' != base[0]))	{ continue; }
+#ifndef _WIN32
+			if ('?' == name[-1]) { // symbolic link or unknown type, check target once
+				snprintf (full, sizeof(full), "%s/%s", dir, name);
+				pCache->names[lo][-1] = ((0 == stat (full, &st)) && S_ISDIR (st.st_mode)) ? 'd' : 'f';
+			}
+#endif
+			is_dir = ('d' == name[-1]);
+			crossline_path_add (pCompletions, name, is_dir, 0 != quote);
+		}
+	}
+	if (s_path_lock_on)	{ crossline_mutex_unlock (&s_path_lock); }
+}
+
+/*****************************************************************************/
+
+/* Frecency store counts accepted completion words, count decays by half every half life.
+ * It's an open addressing hash table (slot 0 is never used as word offset 0 means empty) with
+ * string pool, saved file is the table image. Loaded file is mapped read only and copied on first update.
+ */
+
+typedef struct crossline_frec_slot_t {
+	uint32_t	hash, word;		// Word hash and offset in pool, 0 is empty slot
+	float		score;			// Decayed count at time
+	uint32_t	time;			// Minutes since epoch of last update
+} crossline_frec_slot_t;
+
+typedef struct crossline_frec_file_t {
+	char		magic[8];
+	uint32_t	byte_order, version;
+	uint32_t	slot_num, used, pool_len, reserved;
+} crossline_frec_file_t;
+
+#define CROSS_FREC_MAGIC		"CLFREC\0\0"
+#define CROSS_FREC_VERSION		1
+#define CROSS_FREC_BYTE_ORDER	0x01020304
+
+static struct {
+	crossline_frec_slot_t	*slots;	// slot_num is power of 2
+	char		*pool;
+	uint32_t	slot_num, used, pool_len, pool_max;
+	void		*map;		// Mapped file, slots and pool point to it until first update
+	size_t		map_size;
+} s_frec;
+static int		s_frec_on			= 0; // Rank completions by frecency and record accepted words
+static int		s_frec_half_life	= CROSS_FRECENCY_HALF_LIFE * 60; // Minutes
+
+static uint32_t crossline_frec_now (void)
+{
+	return (uint32_t)(time (NULL) / 60);
+}
+
+// Score decayed to now, 0.5^x is approximated by halving and linear fraction.
+static float crossline_frec_score (const crossline_frec_slot_t *pSlot, uint32_t now)
+{
+	uint32_t age = (now > pSlot->time) ? now - pSlot->time : 0, half = (uint32_t)s_frec_half_life;
+	if (age / half >= 32)	{ return 0; }
+	return pSlot->score / (float)(1u << (age / half)) * (1.0f - 0.5f * (float)(age % half) / (float)half);
+}
+
+// Find slot of word or empty slot for it, return NULL if word isn't found in full table.
+static crossline_frec_slot_t* crossline_frec_find (const char *word, uint32_t hash)
+{
+	uint32_t i, n, mask = s_frec.slot_num - 1;
+	crossline_frec_slot_t *pSlot;
+	for (i = hash & mask, n = 0; n < s_frec.slot_num; i = (i + 1) & mask, ++n) {
+		pSlot = &s_frec.slots[i];
+		if ((0 == pSlot->word) || ((pSlot->hash == hash) && !strcmp (&s_frec.pool[pSlot->word], word)))
+			{ return pSlot; }
+	}
+	return NULL;
+}
+
+// Return decayed score of word, 0 if never accepted.
+static float crossline_frec_lookup (const char *word, uint32_t now)
+{
+	crossline_frec_slot_t *pSlot;
+	if (0 == s_frec.used)	{ return 0; }
+	pSlot = crossline_frec_find (word, crossline_hash (word));
+	return ((NULL != pSlot) && pSlot->word) ? crossline_frec_score (pSlot, now) : 0;
+}
+
+// Rebuild table with slot_num slots and only words whose score is not less than min, return 0 if OK.
+static int crossline_frec_rebuild (uint32_t slot_num, float min)
+{
+	crossline_frec_slot_t *old = s_frec.slots, *pSlot;
+	char	*old_pool = s_frec.pool;
+	uint32_t i, old_num = s_frec.slot_num, now = crossline_frec_now (), len, max = 0;
+	void	*map = s_frec.map;
+
+	s_frec.slots = (crossline_frec_slot_t*)calloc (slot_num, sizeof(crossline_frec_slot_t));
+	s_frec.pool = NULL;
+	if ((NULL == s_frec.slots) || (crossline_array_grow ((void**)&s_frec.pool, &max, s_frec.pool_len ? s_frec.pool_len : 1024, 1) < 0)) {
+		free (s_frec.slots);
+		s_frec.slots = old;
+		s_frec.pool = old_pool;
+		return -1;
+	}
+	s_frec.slot_num = slot_num;
+	s_frec.pool_max = max;
+	s_frec.pool_len = 1;
+	s_frec.used = 0;
+	s_frec.map = NULL;
+	for (i = 0; i < old_num; ++i) {
+		if (!old[i].word || (crossline_frec_score (&old[i], now) < min))	{ continue; }
+		if (NULL == (pSlot = crossline_frec_find (&old_pool[old[i].word], old[i].hash)))	{ continue; }
+		*pSlot = old[i];
+		len = (uint32_t)strlen (&old_pool[old[i].word]) + 1;
+		memcpy (&s_frec.pool[s_frec.pool_len], &old_pool[old[i].word], len);
+		pSlot->word = s_frec.pool_len;
+		s_frec.pool_len += len;
+		s_frec.used++;
+	}
+	if (NULL != map) {
+		crossline_file_unmap (map, s_frec.map_size);
+	} else {
+		free (old);
+		free (old_pool);
+	}
+	return 0;
+}
+
+// Record accepted completion word.
+void crossline_frecency_add (const char *word)
+{
+	crossline_frec_slot_t *pSlot;
+	uint32_t hash, len, slot_num, now = crossline_frec_now ();
+
+	if ((NULL == word) || ('\0' == word[0]))	{ return; }
+	if ((NULL != s_frec.map) || (2 * (s_frec.used + 1) > s_frec.slot_num)) { // own mapped table or grow
+		for (slot_num = (s_frec.slot_num >= 64) ? s_frec.slot_num : 64; 2 * (s_frec.used + 1) > slot_num; slot_num *= 2)	;
+		if (crossline_frec_rebuild (slot_num, 0) < 0)	{ return; }
+	}
+	hash = crossline_hash (word);
+	if (NULL == (pSlot = crossline_frec_find (word, hash)))	{ return; }
+	if (0 == pSlot->word) {
+		len = (uint32_t)strlen (word) + 1;
+		if (crossline_array_grow ((void**)&s_frec.pool, &s_frec.pool_max, s_frec.pool_len + len, 1) < 0)	{ return; }
+		memcpy (&s_frec.pool[s_frec.pool_len], word, len);
+		pSlot->hash		= hash;
+		pSlot->word		= s_frec.pool_len;
+		pSlot->score	= 0;
+		pSlot->time		= now;
+		s_frec.pool_len += len;
+		s_frec.used++;
+	}
+	pSlot->score = crossline_frec_score (pSlot, now) + 1;
+	pSlot->time = now;
+}
+
+// Clear frecency store.
+void crossline_frecency_clear (void)
+{
+	if (NULL != s_frec.map) {
+		crossline_file_unmap (s_frec.map, s_frec.map_size);
+	} else {
+		free (s_frec.slots);
+		free (s_frec.pool);
+	}
+	memset (&s_frec, 0, sizeof(s_frec));
+}
+
+// Enable/Disable frecency ranking with half life in hours, return previous setting.
+int crossline_completion_frecency_set (int enable, int half_life_hours)
+{
+	int prev = s_frec_on;
+	s_frec_on = enable;
+	s_frec_half_life = ((half_life_hours > 0) ? half_life_hours : CROSS_FRECENCY_HALF_LIFE) * 60;
+	return prev;
+}
+
+// Save frecency store to table image file, decayed out words are dropped. Return 0 if OK.
+int crossline_frecency_save (const char *filename)
+{
+	crossline_frec_file_t hdr;
+	FILE	*file;
+	int		ret = 0;
+	uint32_t slot_num;
+
+	if (NULL == filename)	{ return -1; }
+	for (slot_num = 64; slot_num < 2 * s_frec.used; slot_num *= 2)	;
+	if (crossline_frec_rebuild (slot_num, 0.01f) < 0)	{ return -1; }
+	if (NULL == (file = fopen (filename, "wb")))	{ return -1; }
+	memset (&hdr, 0, sizeof(hdr));
+	memcpy (hdr.magic, CROSS_FREC_MAGIC, sizeof(hdr.magic));
+	hdr.byte_order	= CROSS_FREC_BYTE_ORDER;
+	hdr.version		= CROSS_FREC_VERSION;
+	hdr.slot_num	= s_frec.slot_num;
+	hdr.used		= s_frec.used;
+	hdr.pool_len	= s_frec.pool_len;
+	if ((1 != fwrite (&hdr, sizeof(hdr), 1, file)) ||
+		(s_frec.slot_num != fwrite (s_frec.slots, sizeof(crossline_frec_slot_t), s_frec.slot_num, file)) ||
+		(s_frec.pool_len != fwrite (s_frec.pool, 1, s_frec.pool_len, file)))
+		{ ret = -1; }
+	if (0 != fclose (file))	{ ret = -1; }
+	return ret;
+}
+
+// Load frecency store file with read only mapping and enable frecency ranking, return 0 if OK.
+int crossline_frecency_load (const char *filename)
+{
+	size_t	size = 0;
+	crossline_frec_file_t *hdr;
+	crossline_frec_slot_t *slots;
+	uint32_t i, used = 0;
+
+	if (NULL == filename)	{ return -1; }
+	if (NULL == (hdr = (crossline_frec_file_t*)crossline_file_map (filename, &size)))	{ return -1; }
+	if ((size < sizeof(*hdr)) || memcmp (hdr->magic, CROSS_FREC_MAGIC, sizeof(hdr->magic)) ||
+		(CROSS_FREC_BYTE_ORDER != hdr->byte_order) || (CROSS_FREC_VERSION != hdr->version) ||
+		(hdr->slot_num < 2) || (hdr->slot_num & (hdr->slot_num - 1)) || (hdr->used >= hdr->slot_num) || (hdr->pool_len < 1) ||
+		(size < sizeof(*hdr) + (uint64_t)hdr->slot_num * sizeof(crossline_frec_slot_t) + hdr->pool_len)) {
+		crossline_file_unmap (hdr, size);
+		return -1;
+	}
+	// Words must be in NUL ended pool, and filled slots must match used, so probing always stops at empty slot.
+	slots = (crossline_frec_slot_t*)(hdr + 1);
+	for (i = 0; (i < hdr->slot_num) && (slots[i].word < hdr->pool_len); ++i)
+		{ used += (0 != slots[i].word); }
+	if ((i < hdr->slot_num) || (used != hdr->used) || ('\0' != ((char*)(slots + hdr->slot_num))[hdr->pool_len - 1])) {
+		crossline_file_unmap (hdr, size);
+		return -1;
+	}
+	crossline_frecency_clear ();
+	s_frec.map		= hdr;
+	s_frec.map_size	= size;
+	s_frec.slots	= (crossline_frec_slot_t*)(hdr + 1);
+	s_frec.pool		= (char*)(s_frec.slots + hdr->slot_num);
+	s_frec.slot_num	= hdr->slot_num;
+	s_frec.used		= hdr->used;
+	s_frec.pool_len	= s_frec.pool_max = hdr->pool_len;
+	s_frec_on = 1;
+	return 0;
+}
+
+typedef struct crossline_frec_rank_t {
+	float	score;
+	int		idx;
+} crossline_frec_rank_t;
+
+static int crossline_frec_rank_cmp (const void *a, const void *b)
+{
+	const crossline_frec_rank_t *ra = (const crossline_frec_rank_t*)a, *rb = (const crossline_frec_rank_t*)b;
+	if (ra->score != rb->score)	{ return (ra->score < rb->score) ? 1 : -1; }
+	return ra->idx - rb->idx; // keep source order
+}
+
+/* Reorder completions by frecency, words never accepted keep their order after accepted ones.
+ * Return 1 if first word dominates others and should be completed by TAB.
+ */
+static int crossline_frecency_rank (crossline_completions_t *pCompletions)
+{
+	crossline_frec_rank_t *ranks;
+	crossline_completion_item_t *items;
+	int i, hits = 0, dominant;
+	uint32_t now = crossline_frec_now ();
+
+	if (!s_frec_on || (0 == s_frec.used) || (pCompletions->num < 2))	{ return 0; }
+	if (NULL == (ranks = (crossline_frec_rank_t*)malloc (pCompletions->num * sizeof(*ranks))))	{ return 0; }
+	for (i = 0; i < pCompletions->num; ++i) {
+		ranks[i].score = crossline_frec_lookup (pCompletions->items[i].word, now);
+		ranks[i].idx = i;
+		hits += (ranks[i].score > 0);
+	}
+	if ((0 == hits) || (NULL == (items = (crossline_completion_item_t*)malloc (pCompletions->num * sizeof(*items))))) {
+		free (ranks);
+		return 0;
+	}
+	qsort (ranks, pCompletions->num, sizeof(*ranks), crossline_frec_rank_cmp);
+	for (i = 0; i < pCompletions->num; ++i)	{ items[i] = pCompletions->items[ranks[i].idx]; }
+	memcpy (pCompletions->items, items, pCompletions->num * sizeof(*items));
+	dominant = (ranks[0].score >= 2) && (ranks[0].score >= CROSS_FRECENCY_DOMINANT * ranks[1].score);
+	free (items);
+	free (ranks);
+	return dominant;
+}
+
+/*****************************************************************************/
+
+/* Fuzzy matching: pattern chars must appear in word in order (case insensitive).
+ * Candidates are prefiltered by char class bitmask, 4 masks per compare with SSE2.
+ * Score rewards matches at word start, after separator and at camelCase hump and consecutive
+ * matches, and charges gaps inside the shortest matched window. Exact prefix ranks first.
+ */
+
+// Char class bitmask: a-z (case folded), digit, '_', '-', '.', other ASCII, non-ASCII
+static uint32_t crossline_fuzzy_mask (const char *str)
+{
+	uint32_t mask = 0;
+	int ch;
+	for (; '\0' != *str; ++str) {
+		ch = tolower ((unsigned char)*str);
+		if ((ch >= 'a') && (ch <= 'z'))	{ mask |= 1u << (ch - 'a'); }
+		else if (isdigit (ch))		{ mask |= 1u << 26; }
+		else if ('_' == ch)			{ mask |= 1u << 27; }
+		else if ('-' == ch)			{ mask |= 1u << 28; }
+		else if ('.' == ch)			{ mask |= 1u << 29; }
+		else if (ch < 0x80)			{ mask |= 1u << 30; }
+		else						{ mask |= 1u << 31; }
+	}
+	return mask;
+}
+
+// Fold at most len bytes of src to pattern, return pattern length.
+static int crossline_fuzzy_pattern (char *pat, const char *src, int len)
+{
+	int i;
+	if (len > CROSS_HISTORY_BUF_LEN - 1)	{ len = CROSS_HISTORY_BUF_LEN - 1; }
+	for (i = 0; (i < len) && ('\0' != src[i]); ++i)	{ pat[i] = (char)tolower ((unsigned char)src[i]); }
+	pat[i] = '\0';
+	return i;
+}
+
+#define CROSS_FOLD(ch)	((((ch) >= 'A') && ((ch) <= 'Z')) ? (ch) + 32 : (ch))
+
+// Return score of case folded pattern in word, -1 if not matched.
+static int crossline_fuzzy_score (const char *pat, int plen, const char *word)
+{
+	int i, j, start, prev = -2, score = 0, bonus;
+	unsigned char ch, last;
+
+	for (i = j = 0; ('\0' != word[i]) && (j < plen); ++i) {
+		ch = (unsigned char)word[i];
+		if (CROSS_FOLD(ch) == (unsigned char)pat[j])	{ j++; }
+	}
+	if (j < plen)	{ return -1; }
+	// shrink window backward from first full match end
+	for (j = plen; j > 0; ) {
+		ch = (unsigned char)word[--i];
+		if (CROSS_FOLD(ch) == (unsigned char)pat[j-1])	{ j--; }
+	}
+	for (start = i, j = 0; j < plen; ++i) {
+		ch = (unsigned char)word[i];
+		if (CROSS_FOLD(ch) != (unsigned char)pat[j]) {
+			score -= (i > start) ? 2 : 0;
+			continue;
+		}
+		last = i ? (unsigned char)word[i-1] : ' ';
+		bonus = 0;
+		if (!isalnum (last))	{ bonus = 10; }
+		else if (islower (last) && isupper (ch))	{ bonus = 8; }
+		if (prev == i - 1)	{ bonus += 5; }
+		score += 16 + bonus;
+		prev = i;
+		j++;
+	}
+	if (0 == start)	{ score += 20; }
+	return score - (start < 10 ? start : 10);
+}
+
+/*****************************************************************************/
+
+/* Completion dictionary is a case insensitive radix trie.
+ * Nodes, entries and strings are kept in arrays and linked by index, so it can be saved and mapped as is.
+ * Node 0 is root, child and next 0 mean none. Entry and string offset 0 mean none.
+ */
+
+typedef struct crossline_dict_node_t {
+	uint32_t	label, label_len;	// Case folded edge label in string pool
+	uint32_t	child, next;		// First child (sorted by first label byte) and next sibling
+	uint32_t	entry;				// First entry ending at this node
+	uint32_t	depth;				// Key length from root to end of this node
+} crossline_dict_node_t;
+
+typedef struct crossline_dict_entry_t {
+	uint32_t	word, help;			// Original word and help in string pool
+	uint32_t	color_word, color_help;
+	uint32_t	next;				// Next entry with same folded key
+} crossline_dict_entry_t;
+
+struct crossline_dict_t {
+	crossline_dict_node_t	*nodes;
+	crossline_dict_entry_t	*entries;
+	char		*pool;
+	uint32_t	node_num, node_max, entry_num, entry_max, pool_len, pool_max;
+	void		*map;		// Mapped dictionary file, read only
+	size_t		map_size;
+	uint32_t	*masks;		// Fuzzy prefilter masks of entries, built on first fuzzy match
+	uint32_t	mask_num, mask_max;
+	uint32_t	*hits;		// Entries matching last fuzzy pattern, longer pattern only scans them
+	uint32_t	hit_num, hit_max, hit_entry_num;
+	char		*hit_pat;
+};
+
+// Compiled dictionary file header, followed by nodes, entries and string pool.
+typedef struct crossline_dict_file_t {
+	char		magic[8];
+	uint32_t	byte_order, version;
+	uint32_t	node_num, entry_num, pool_len;
+	uint32_t	node_off, entry_off, pool_off;
+} crossline_dict_file_t;
+
+#define CROSS_DICT_MAGIC		"CLDICT\0\0"
+#define CROSS_DICT_VERSION		1
+#define CROSS_DICT_BYTE_ORDER	0x01020304
+
+crossline_dict_t* crossline_dict_create (void)
+{
+	crossline_dict_t *pDict = (crossline_dict_t*)calloc (1, sizeof(crossline_dict_t));
+	if (NULL == pDict)	{ return NULL; }
+	pDict->nodes	= (crossline_dict_node_t*)calloc (64, sizeof(crossline_dict_node_t));
+	pDict->entries	= (crossline_dict_entry_t*)calloc (64, sizeof(crossline_dict_entry_t));
+	pDict->pool		= (char*)calloc (4096, 1);
+	if ((NULL == pDict->nodes) || (NULL == pDict->entries) || (NULL == pDict->pool)) {
+		crossline_dict_free (pDict);
+		return NULL;
+	}
+	pDict->node_num = pDict->entry_num = pDict->pool_len = 1; // root node, empty entry and empty string
+	pDict->node_max = pDict->entry_max = 64;
+	pDict->pool_max = 4096;
+	return pDict;
+}
+
+void crossline_dict_free (crossline_dict_t *pDict)
+{
+	if ((NULL != pDict) && (NULL != pDict->map)) {
+		crossline_file_unmap (pDict->map, pDict->map_size);
+		free (pDict->masks);
+		free (pDict->hits);
+		free (pDict->hit_pat);
+		free (pDict);
+	} else if (NULL != pDict) {
+		free (pDict->nodes);
+		free (pDict->entries);
+		free (pDict->pool);
+		free (pDict->masks);
+		free (pDict->hits);
+		free (pDict->hit_pat);
+		free (pDict);
+	}
+}
+
+static uint32_t crossline_dict_str (crossline_dict_t *pDict, const char *str, int len)
+{
+	uint32_t off = pDict->pool_len;
+	if (crossline_array_grow ((void**)&pDict->pool, &pDict->pool_max, pDict->pool_len + len + 1, 1) < 0)
+		{ return 0; }
+	memcpy (&pDict->pool[off], str, len);
+	pDict->pool[off + len] = '\0';
+	pDict->pool_len += len + 1;
+	return off;
+}
+
+static uint32_t crossline_dict_node (crossline_dict_t *pDict, uint32_t label, uint32_t label_len, uint32_t depth)
+{
+	crossline_dict_node_t *node;
+	if (crossline_array_grow ((void**)&pDict->nodes, &pDict->node_max, pDict->node_num + 1, sizeof(*node)) < 0)
+		{ return 0; }
+	node = &pDict->nodes[pDict->node_num];
+	memset (node, 0, sizeof(*node));
+	node->label		= label;
+	node->label_len	= label_len;
+	node->depth		= depth;
+	return pDict->node_num++;
+}
+
+// Add word with help and colors, return 0 if OK, -1 if no memory.
+int crossline_dict_add_color (crossline_dict_t *pDict, const char *word, crossline_color_e wcolor, 
+								const char *help, crossline_color_e hcolor)
+{
+	uint32_t id = 0, *link, child, mid, key, len, k = 0, m, entry, next;
+	crossline_dict_node_t *nodes;
+	crossline_dict_entry_t *pEntry;
+	const char *label;
+
+	if ((NULL == pDict) || (NULL != pDict->map) || (NULL == word) || ('\0' == word[0]))	{ return -1; }
+	len = (uint32_t)strlen (word);
+	if (0 == (key = crossline_dict_str (pDict, word, len)))	{ return -1; }
+	crossline_str_fold (&pDict->pool[key], &pDict->pool[key]);
+	while (k < len) {
+		nodes = pDict->nodes;
+		// find child with same first byte, children are sorted by first byte
+		for (link = &nodes[id].child; *link && ((uint8_t)pDict->pool[nodes[*link].label] < (uint8_t)pDict->pool[key+k]); link = &nodes[*link].next)	;
+		child = *link;
+		if (!child || (pDict->pool[nodes[child].label] != pDict->pool[key+k])) {
+			next = child;
+			if (0 == (child = crossline_dict_node (pDict, key+k, len-k, len)))	{ return -1; }
+			nodes = pDict->nodes;	// link may be moved by realloc, find again
+			for (link = &nodes[id].child; *link != next; link = &nodes[*link].next)	;
+			nodes[child].next = next;
+			*link = child;
+			id = child;
+			break;
+		}
+		label = &pDict->pool[nodes[child].label];
+		for (m = 1; (m < nodes[child].label_len) && (k+m < len) && (label[m] == pDict->pool[key+k+m]); ++m)	;
+		if (m < nodes[child].label_len) { // split edge at m
+			if (0 == (mid = crossline_dict_node (pDict, nodes[child].label, m, nodes[child].depth - nodes[child].label_len + m)))
+				{ return -1; }
+			nodes = pDict->nodes;
+			for (link = &nodes[id].child; *link != child; link = &nodes[*link].next)	;
+			*link = mid;
+			nodes[mid].next		= nodes[child].next;
+			nodes[mid].child	= child;
+			nodes[child].next	= 0;
+			nodes[child].label	+= m;
+			nodes[child].label_len -= m;
+			child = mid;
+		}
+		id = child;
+		k += m;
+	}
+	if (crossline_array_grow ((void**)&pDict->entries, &pDict->entry_max, pDict->entry_num + 1, sizeof(*pEntry)) < 0)
+		{ return -1; }
+	entry = pDict->entry_num++;
+	pEntry = &pDict->entries[entry];
+	memset (pEntry, 0, sizeof(*pEntry));
+	if ((0 == (pEntry->word = crossline_dict_str (pDict, word, len))) || 
+		((NULL != help) && (0 == (pEntry->help = crossline_dict_str (pDict, help, (int)strlen(help))))))
+		{ pDict->entry_num--; return -1; }
+	pEntry->color_word	= wcolor;
+	pEntry->color_help	= hcolor;
+	// append to entry list to keep adding order for same key
+	for (link = &pDict->nodes[id].entry; *link; link = &pDict->entries[*link].next)	;
+	*link = entry;
+	return 0;
+}
+int crossline_dict_add (crossline_dict_t *pDict, const char *word, const char *help)
+{
+	return crossline_dict_add_color (pDict, word, CROSSLINE_COLOR_DEFAULT, help, CROSSLINE_COLOR_DEFAULT);
+}
+
+// Add all entries in subtree in key order.
+static int crossline_dict_walk (crossline_dict_t *pDict, uint32_t id, crossline_completions_t *pCompletions)
+{
+	int count = 0;
+	uint32_t entry;
+	crossline_dict_entry_t *pEntry;
+
+	for (entry = pDict->nodes[id].entry; entry; entry = pEntry->next, ++count) {
+		pEntry = &pDict->entries[entry];
+		crossline_completion_add_static_color (pCompletions, &pDict->pool[pEntry->word], (crossline_color_e)pEntry->color_word, 
+								pEntry->help ? &pDict->pool[pEntry->help] : NULL, (crossline_color_e)pEntry->color_help);
+	}
+	for (id = pDict->nodes[id].child; id; id = pDict->nodes[id].next)
+		{ count += crossline_dict_walk (pDict, id, pCompletions); }
+	return count;
+}
+
+// Find node whose subtree holds all keys starting with prefix, return -1 if none.
+static int crossline_dict_find (crossline_dict_t *pDict, const char *prefix)
+{
+	uint32_t id = 0, k = 0, m, len;
+	char	key[CROSS_HISTORY_BUF_LEN];
+	const char *label;
+	crossline_dict_node_t *nodes = pDict->nodes;
+
+	strncpy (key, prefix, sizeof(key) - 1);
+	key[sizeof(key) - 1] = '\0';
+	len = (uint32_t)crossline_str_fold (key, key);
+	while (k < len) {
+		for (id = nodes[id].child; id && (pDict->pool[nodes[id].label] != key[k]); id = nodes[id].next)	;
+		if (!id)	{ return -1; }
+		label = &pDict->pool[nodes[id].label];
+		for (m = 1; (m < nodes[id].label_len) && (k+m < len) && (label[m] == key[k+m]); ++m)	;
+		if ((m < nodes[id].label_len) && (k+m < len))	{ return -1; }
+		k += m;
+	}
+	return (int)id;
+}
+
+// Add all words starting with prefix (case insensitive) to completions, return number of words added.
+int crossline_dict_complete (crossline_dict_t *pDict, const char *prefix, crossline_completions_t *pCompletions)
+{
+	int count, only, id;
+	crossline_dict_node_t *nodes;
+
+	if ((NULL == pDict) || (NULL == prefix) || (NULL == pCompletions))	{ return 0; }
+	if ((id = crossline_dict_find (pDict, prefix)) < 0)	{ return 0; }
+	only = (0 == pCompletions->num);
+	count = crossline_dict_walk (pDict, id, pCompletions);
+	if (only && (count > 0)) { // common prefix is where trie stops having single path
+		nodes = pDict->nodes;
+		while (!nodes[id].entry && nodes[id].child && !nodes[nodes[id].child].next)
+			{ id = nodes[id].child; }
+		pCompletions->common_len = (int)nodes[id].depth;
+	}
+	return count;
+}
+
+typedef struct crossline_fuzzy_hit_t {
+	int			score, len;
+	uint32_t	entry;
+} crossline_fuzzy_hit_t;
+
+// Return 1 if hit a ranks lower than hit b: lower score, then longer word, then later added.
+static int crossline_fuzzy_lower (const crossline_fuzzy_hit_t *a, const crossline_fuzzy_hit_t *b)
+{
+	if (a->score != b->score)	{ return a->score < b->score; }
+	if (a->len != b->len)		{ return a->len > b->len; }
+	return a->entry > b->entry;
+}
+
+// Sift down hit at i in min heap (lowest rank at top).
+static void crossline_fuzzy_sift (crossline_fuzzy_hit_t *heap, int num, int i)
+{
+	crossline_fuzzy_hit_t hit = heap[i];
+	int child;
+	for (; (child = 2*i + 1) < num; i = child) {
+		if ((child + 1 < num) && crossline_fuzzy_lower (&heap[child+1], &heap[child]))	{ child++; }
+		if (!crossline_fuzzy_lower (&heap[child], &hit))	{ break; }
+		heap[i] = heap[child];
+	}
+	heap[i] = hit;
+}
+
+// Score entry and keep it if it's in top_k best, matched entry is appended to hits.
+static void crossline_fuzzy_rank (crossline_dict_t *pDict, uint32_t entry, const char *pat, int plen, 
+									crossline_fuzzy_hit_t *heap, int *pNum, int top_k)
+{
+	crossline_fuzzy_hit_t hit;
+	int i;
+	const char *word = &pDict->pool[pDict->entries[entry].word];
+
+	if ((hit.score = crossline_fuzzy_score (pat, plen, word)) < 0)	{ return; }
+	pDict->hits[pDict->hit_num++] = entry;
+	if ((*pNum == top_k) && (hit.score < heap[0].score))	{ return; }
+	hit.len		= (int)strlen (word);
+	hit.entry	= entry;
+	if (*pNum < top_k) { // sift up
+		for (i = (*pNum)++; (i > 0) && crossline_fuzzy_lower (&hit, &heap[(i-1)/2]); i = (i-1)/2)
+			{ heap[i] = heap[(i-1)/2]; }
+		heap[i] = hit;
+	} else if (crossline_fuzzy_lower (&heap[0], &hit)) {
+		heap[0] = hit;
+		crossline_fuzzy_sift (heap, *pNum, 0);
+	}
+}
+
+/* Add top_k best words fuzzy matching pattern (case insensitive subsequence) to completions by score,
+ * return number of words added. Matched entries are kept, so if pattern is extended (typing more), 
+ * only they are scanned again.
+ */
+int crossline_dict_fuzzy (crossline_dict_t *pDict, const char *pattern, crossline_completions_t *pCompletions, int top_k)
+{
+	char	pat[CROSS_HISTORY_BUF_LEN];
+	int		plen, num = 0, i;
+	uint32_t entry, qmask, *masks, hit_num;
+	crossline_fuzzy_hit_t *heap, hit;
+	crossline_dict_entry_t *pEntry;
+#ifdef CROSS_FUZZY_SSE2
+	__m128i	q, m;
+	int		bits;
+#endif
+
+	if ((NULL == pDict) || (NULL == pattern) || (NULL == pCompletions) || (top_k <= 0))	{ return 0; }
+	plen = crossline_fuzzy_pattern (pat, pattern, (int)strlen (pattern));
+	if ((pDict->entry_num > pDict->mask_num) && (pDict->entry_num > 1)) { // mask new entries
+		if (crossline_array_grow ((void**)&pDict->masks, &pDict->mask_max, pDict->entry_num, sizeof(uint32_t)) < 0)
+			{ return 0; }
+		for (entry = pDict->mask_num ? pDict->mask_num : 1; entry < pDict->entry_num; ++entry)
+			{ pDict->masks[entry] = crossline_fuzzy_mask (&pDict->pool[pDict->entries[entry].word]); }
+		pDict->mask_num = pDict->entry_num;
+	}
+	if ((pDict->entry_num <= 1) || 
+		(crossline_array_grow ((void**)&pDict->hits, &pDict->hit_max, pDict->entry_num, sizeof(uint32_t)) < 0) ||
+		(NULL == (heap = (crossline_fuzzy_hit_t*)malloc (top_k * sizeof(*heap)))))
+		{ return 0; }
+	if ((NULL != pDict->hit_pat) && (pDict->hit_entry_num == pDict->entry_num) && 
+		!strncmp (pat, pDict->hit_pat, strlen (pDict->hit_pat))) { // narrow last matched entries
+		hit_num = pDict->hit_num;
+		for (pDict->hit_num = 0, i = 0; i < (int)hit_num; ++i)
+			{ crossline_fuzzy_rank (pDict, pDict->hits[i], pat, plen, heap, &num, top_k); }
+		entry = pDict->entry_num;
+	} else {
+		pDict->hit_num = 0;
+		entry = 1;
+	}
+	free (pDict->hit_pat);
+	if (NULL != (pDict->hit_pat = (char*)malloc (plen + 1)))	{ memcpy (pDict->hit_pat, pat, plen + 1); }
+	pDict->hit_entry_num = pDict->entry_num;
+	qmask = crossline_fuzzy_mask (pat);
+	masks = pDict->masks;
+#ifdef CROSS_FUZZY_SSE2
+	q = _mm_set1_epi32 ((int)qmask);
+	for (; entry + 4 <= pDict->entry_num; entry += 4) {
+		m = _mm_loadu_si128 ((const __m128i*)&masks[entry]);
+		bits = _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (_mm_and_si128 (m, q), q)));
+		for (i = 0; bits; ++i, bits >>= 1) {
+			if (bits & 1)	{ crossline_fuzzy_rank (pDict, entry + i, pat, plen, heap, &num, top_k); }
+		}
+	}
+#endif
+	for (; entry < pDict->entry_num; ++entry) {
+		if ((masks[entry] & qmask) == qmask)	{ crossline_fuzzy_rank (pDict, entry, pat, plen, heap, &num, top_k); }
+	}
+	// pop lowest to end, then heap is sorted from best to worst
+	for (i = num - 1; i > 0; --i) {
+		hit = heap[0];
+		heap[0] = heap[i];
+		heap[i] = hit;
+		crossline_fuzzy_sift (heap, i, 0);
+	}
+	for (i = 0; i < num; ++i) {
+		pEntry = &pDict->entries[heap[i].entry];
+		crossline_completion_add_static_color (pCompletions, &pDict->pool[pEntry->word], (crossline_color_e)pEntry->color_word, 
+								pEntry->help ? &pDict->pool[pEntry->help] : NULL, (crossline_color_e)pEntry->color_help);
+	}
+	free (heap);
+	if (pCompletions->num > 1)	{ pCompletions->common_len = 0; } // no common prefix to insert
+	return num;
+}
+
+// Save dictionary to compiled file which can be mapped by crossline_dict_load, return 0 if OK.
+int crossline_dict_save (crossline_dict_t *pDict, const char *filename)
+{
+	FILE *file;
+	int ret = 0;
+	crossline_dict_file_t hdr;
+
+	if ((NULL == pDict) || (NULL == filename))	{ return -1; }
+	memset (&hdr, 0, sizeof(hdr));
+	memcpy (hdr.magic, CROSS_DICT_MAGIC, sizeof(hdr.magic));
+	hdr.byte_order	= CROSS_DICT_BYTE_ORDER;
+	hdr.version		= CROSS_DICT_VERSION;
+	hdr.node_num	= pDict->node_num;
+	hdr.entry_num	= pDict->entry_num;
+	hdr.pool_len	= pDict->pool_len;
+	hdr.node_off	= sizeof(hdr);
+	hdr.entry_off	= hdr.node_off + pDict->node_num * sizeof(crossline_dict_node_t);
+	hdr.pool_off	= hdr.entry_off + pDict->entry_num * sizeof(crossline_dict_entry_t);
+	if (NULL == (file = fopen (filename, "wb")))	{ return -1; }
+	if ((1 != fwrite (&hdr, sizeof(hdr), 1, file)) ||
+		(pDict->node_num != fwrite (pDict->nodes, sizeof(crossline_dict_node_t), pDict->node_num, file)) ||
+		(pDict->entry_num != fwrite (pDict->entries, sizeof(crossline_dict_entry_t), pDict->entry_num, file)) ||
+		(pDict->pool_len != fwrite (pDict->pool, 1, pDict->pool_len, file)))
+		{ ret = -1; }
+	if (fclose (file))	{ ret = -1; }
+	return ret;
+}
+
+/* Check links and string offsets of mapped dictionary, so walking it never reads out of file. Each node and entry
+ * is linked at most once and root is never linked, so walking from root can't loop. Return 0 if OK.
+ */
+static int crossline_dict_check (const crossline_dict_file_t *hdr)
+{
+	const crossline_dict_node_t *nodes = (const crossline_dict_node_t*)((const char*)hdr + hdr->node_off);
+	const crossline_dict_entry_t *entries = (const crossline_dict_entry_t*)((const char*)hdr + hdr->entry_off);
+	uint8_t *node_ref, *entry_ref;
+	uint32_t i, id;
+	int ret = 0;
+
+	node_ref	= (uint8_t*)calloc (hdr->node_num, 1);
+	entry_ref	= (uint8_t*)calloc (hdr->entry_num, 1);
+	if ((NULL == node_ref) || (NULL == entry_ref))	{ ret = 1; }
+	for (i = 0; !ret && (i < hdr->node_num); ++i) {
+		if ((nodes[i].label >= hdr->pool_len) || (nodes[i].label_len > hdr->pool_len - nodes[i].label) ||
+			(nodes[i].child >= hdr->node_num) || (nodes[i].next >= hdr->node_num) || (nodes[i].entry >= hdr->entry_num))
+			{ ret = 1; break; }
+		if ((0 == i) && nodes[i].next)	{ ret = 1; break; } // root has no sibling
+		id = nodes[i].child;
+		if (id && node_ref[id]++)	{ ret = 1; break; }
+		id = nodes[i].next;
+		if (id && node_ref[id]++)	{ ret = 1; break; }
+		id = nodes[i].entry;
+		if (id && entry_ref[id]++)	{ ret = 1; break; }
+	}
+	for (i = 1; !ret && (i < hdr->entry_num); ++i) {
+		if ((entries[i].word >= hdr->pool_len) || (entries[i].help >= hdr->pool_len) || (entries[i].next >= hdr->entry_num))
+			{ ret = 1; break; }
+		id = entries[i].next;
+		if (id && entry_ref[id]++)	{ ret = 1; break; }
+	}
+	if (!ret && (node_ref[0] || entry_ref[0]))	{ ret = 1; }
+	free (node_ref);
+	free (entry_ref);
+	return ret;
+}
+
+// Load compiled dictionary by mapping file read only (processes share pages), file is rejected if any check fails.
+crossline_dict_t* crossline_dict_load (const char *filename)
+{
+	size_t size = 0;
+	crossline_dict_file_t *hdr;
+	crossline_dict_t *pDict;
+
+	if (NULL == filename)	{ return NULL; }
+	if (NULL == (hdr = (crossline_dict_file_t*)crossline_file_map (filename, &size)))	{ return NULL; }
+	if ((size < sizeof(*hdr)) || memcmp (hdr->magic, CROSS_DICT_MAGIC, sizeof(hdr->magic)) ||
+		(CROSS_DICT_BYTE_ORDER != hdr->byte_order) || (CROSS_DICT_VERSION != hdr->version) ||
+		(hdr->node_num < 1) || (hdr->entry_num < 1) || (hdr->pool_len < 1) ||
+		(hdr->node_off != sizeof(*hdr)) ||
+		(hdr->entry_off != hdr->node_off + (uint64_t)hdr->node_num * sizeof(crossline_dict_node_t)) ||
+		(hdr->pool_off != hdr->entry_off + (uint64_t)hdr->entry_num * sizeof(crossline_dict_entry_t)) ||
+		(size < (uint64_t)hdr->pool_off + hdr->pool_len) || ('\0' != ((char*)hdr)[hdr->pool_off + hdr->pool_len - 1]) ||
+		crossline_dict_check (hdr) || (NULL == (pDict = (crossline_dict_t*)calloc (1, sizeof(crossline_dict_t))))) {
+		crossline_file_unmap (hdr, size);
+		return NULL;
+	}
+	pDict->map		= hdr;
+	pDict->map_size	= size;
+	pDict->nodes	= (crossline_dict_node_t*)((char*)hdr + hdr->node_off);
+	pDict->entries	= (crossline_dict_entry_t*)((char*)hdr + hdr->entry_off);
+	pDict->pool		= (char*)hdr + hdr->pool_off;
+	pDict->node_num = pDict->node_max = hdr->node_num;
+	pDict->entry_num = pDict->entry_max = hdr->entry_num;
+	pDict->pool_len = pDict->pool_max = hdr->pool_len;
+	return pDict;
+}
+
+// Register dictionary to complete last word in TAB without callback, NULL to unregister.
+void crossline_dict_register (crossline_dict_t *pDict)
+{
+	s_completion_dict = pDict;
+}
+
+// Enable/Disable fuzzy matching, return previous setting.
+int crossline_completion_fuzzy_set (int enable, int top_k)
+{
+	int prev = s_fuzzy_on;
+	s_fuzzy_on = enable;
+	s_fuzzy_top = (top_k > 0) ? top_k : CROSS_COMPLET_FUZZY_TOP;
+	return prev;
+}
+
+/*****************************************************************************/
+
+/* Grammar rules are compiled into one NFA (Thompson construction) shared by all commands:
+ *   word      keyword, matched case insensitive and completed as declared
+ *   <name>    placeholder for one token, hint and value provider come from crossline_grammar_type_add
+ *   [ ... ]   optional group, { ... } required group, '|' separates alternatives in group
+ *   ...       repeat previous item, [x]... is zero or more times, x... and {x}... are one or more times
+ * Tokens are separated by spaces, keywords take priority over placeholders for same token.
+ * State set after every finished token is cached, so parsing resumes from the last unchanged token.
+ */
+
+enum {
+	CROSS_GRAM_KEY,		// keyword token
+	CROSS_GRAM_ARG,		// placeholder token
+	CROSS_GRAM_SPLIT,	// go to out and out1 without token
+	CROSS_GRAM_NOP,		// go to out without token
+	CROSS_GRAM_MATCH	// end of command
+};
+
+typedef struct crossline_gram_state_t {
+	uint32_t	type;
+	uint32_t	str;	// keyword or placeholder name offset in pool
+	uint32_t	help;	// command help offset in pool, 0 is none
+	int			out, out1;
+} crossline_gram_state_t;
+
+typedef struct crossline_gram_type_t {
+	uint32_t	name, hint;
+	crossline_color_e			color;
+	crossline_grammar_provider	provider;
+	void		*arg;
+} crossline_gram_type_t;
+
+typedef struct crossline_gram_level_t {
+	uint32_t	set_off, set_num;	// state set after token
+	uint32_t	tok_end;			// line offset after token
+} crossline_gram_level_t;
+
+struct crossline_grammar_t {
+	crossline_gram_state_t	*states;
+	crossline_gram_type_t	*types;
+	uint32_t	*rules;		// start state of each command
+	char		*pool;		// strings, offset 0 is empty string
+	uint32_t	state_num, state_max, type_num, type_max, rule_num, rule_max, pool_len, pool_max;
+	crossline_color_e	cmd_color, help_color, key_color;
+
+	// Parse cache
+	crossline_gram_level_t	*levels;
+	uint32_t	*sets;		// state sets of all levels
+	uint32_t	*marks;		// closure visit mark of each state
+	char		*text;		// last parsed line
+	uint32_t	level_num, level_max, set_num, set_max, mark_max, mark_gen, text_max;
+};
+
+typedef struct crossline_gram_frag_t {
+	int		start, end;		// end state's out is not linked yet
+} crossline_gram_frag_t;
+
+crossline_grammar_t* crossline_grammar_create (void)
+{
+	crossline_grammar_t *pGrammar = (crossline_grammar_t*)calloc (1, sizeof(crossline_grammar_t));
+	if (NULL == pGrammar)	{ return NULL; }
+	if (crossline_array_grow ((void**)&pGrammar->pool, &pGrammar->pool_max, 1, 1) < 0) {
+		free (pGrammar);
+		return NULL;
+	}
+	pGrammar->pool[0] = '\0';
+	pGrammar->pool_len = 1;
+	pGrammar->cmd_color = pGrammar->help_color = pGrammar->key_color = CROSSLINE_COLOR_DEFAULT;
+	return pGrammar;
+}
+
+void crossline_grammar_free (crossline_grammar_t *pGrammar)
+{
+	if (NULL != pGrammar) {
+		free (pGrammar->states);
+		free (pGrammar->types);
+		free (pGrammar->rules);
+		free (pGrammar->pool);
+		free (pGrammar->levels);
+		free (pGrammar->sets);
+		free (pGrammar->marks);
+		free (pGrammar->text);
+		free (pGrammar);
+	}
+}
+
+void crossline_grammar_color_set (crossline_grammar_t *pGrammar, crossline_color_e cmd_color, 
+									crossline_color_e help_color, crossline_color_e key_color)
+{
+	if (NULL != pGrammar) {
+		pGrammar->cmd_color		= cmd_color;
+		pGrammar->help_color	= help_color;
+		pGrammar->key_color		= key_color;
+	}
+}
+
+static uint32_t crossline_gram_str (crossline_grammar_t *pGrammar, const char *str, int len)
+{
+	uint32_t off = pGrammar->pool_len;
+	if (crossline_array_grow ((void**)&pGrammar->pool, &pGrammar->pool_max, pGrammar->pool_len + len + 1, 1) < 0)
+		{ return 0; }
+	memcpy (&pGrammar->pool[off], str, len);
+	pGrammar->pool[off + len] = '\0';
+	pGrammar->pool_len += len + 1;
+	return off;
+}
+
+static int crossline_gram_state (crossline_grammar_t *pGrammar, uint32_t type, uint32_t str, int out, int out1)
+{
+	crossline_gram_state_t *state;
+	if (crossline_array_grow ((void**)&pGrammar->states, &pGrammar->state_max, pGrammar->state_num + 1, sizeof(*state)) < 0)
+		{ return -1; }
+	state = &pGrammar->states[pGrammar->state_num];
+	state->type	= type;
+	state->str	= str;
+	state->help	= 0;
+	state->out	= out;
+	state->out1	= out1;
+	return (int)pGrammar->state_num++;
+}
+
+static int crossline_gram_alt (crossline_grammar_t *pGrammar, const char **pSyntax, crossline_gram_frag_t *pFrag);
+
+// Parse keyword, placeholder or group with optional repeat.
+static int crossline_gram_item (crossline_grammar_t *pGrammar, const char **pSyntax, crossline_gram_frag_t *pFrag)
+{
+	const char *syntax = *pSyntax, *end;
+	int len, opt = 0, repeat = 0, loop, exit;
+	uint32_t str;
+
+	if (('[' == *syntax) || ('{' == *syntax)) {
+		opt = '[' == *syntax++;
+		if (crossline_gram_alt (pGrammar, &syntax, pFrag) < 0)	{ return -1; }
+		if (*syntax++ != (opt ? ']' : '}'))	{ return -1; }
+	} else if ('<' == *syntax) {
+		if (NULL == (end = strchr (syntax, '>')))	{ return -1; }
+		if (0 == (str = crossline_gram_str (pGrammar, syntax + 1, (int)(end - syntax - 1))))	{ return -1; }
+		if ((pFrag->start = pFrag->end = crossline_gram_state (pGrammar, CROSS_GRAM_ARG, str, -1, -1)) < 0)
+			{ return -1; }
+		syntax = end + 1;
+	} else {
+		for (len = 0; ('\0' != syntax[len]) && !isspace((unsigned char)syntax[len]) && !strchr ("[]{}<>|", syntax[len]); ++len)	;
+		if ((len > 3) && !strncmp (&syntax[len-3], "...", 3))	{ len -= 3;	repeat = 1; }
+		if (0 == len)	{ return -1; }
+		if (0 == (str = crossline_gram_str (pGrammar, syntax, len)))	{ return -1; }
+		if ((pFrag->start = pFrag->end = crossline_gram_state (pGrammar, CROSS_GRAM_KEY, str, -1, -1)) < 0)
+			{ return -1; }
+		syntax += len + repeat * 3;
+	}
+	for (end = syntax; isspace((unsigned char)*end); ++end)	;
+	if (!repeat && !strncmp (end, "...", 3))	{ syntax = end + 3;	repeat = 1; }
+	*pSyntax = syntax;
+
+	if (!opt && !repeat)	{ return 0; }
+	if ((exit = crossline_gram_state (pGrammar, CROSS_GRAM_NOP, 0, -1, -1)) < 0)	{ return -1; }
+	if ((loop = crossline_gram_state (pGrammar, CROSS_GRAM_SPLIT, 0, pFrag->start, exit)) < 0)	{ return -1; }
+	pGrammar->states[pFrag->end].out = repeat ? loop : exit;
+	pFrag->start	= opt ? loop : pFrag->start;
+	pFrag->end		= exit;
+	return 0;
+}
+
+// Parse items till '|', close bracket or end.
+static int crossline_gram_seq (crossline_grammar_t *pGrammar, const char **pSyntax, crossline_gram_frag_t *pFrag)
+{
+	crossline_gram_frag_t item;
+	int first = 1;
+
+	for (;;) {
+		while (isspace((unsigned char)**pSyntax))	{ ++*pSyntax; }
+		if (('\0' == **pSyntax) || strchr ("|]}", **pSyntax))	{ break; }
+		if (crossline_gram_item (pGrammar, pSyntax, &item) < 0)	{ return -1; }
+		if (first) {
+			*pFrag = item;
+			first = 0;
+		} else {
+			pGrammar->states[pFrag->end].out = item.start;
+			pFrag->end = item.end;
+		}
+	}
+	if (first) {
+		pFrag->start = pFrag->end = crossline_gram_state (pGrammar, CROSS_GRAM_NOP, 0, -1, -1);
+	}
+	return pFrag->start < 0 ? -1 : 0;
+}
+
+// Parse alternatives separated by '|'.
+static int crossline_gram_alt (crossline_grammar_t *pGrammar, const char **pSyntax, crossline_gram_frag_t *pFrag)
+{
+	crossline_gram_frag_t frag;
+	int split, end = -1;
+
+	if (crossline_gram_seq (pGrammar, pSyntax, pFrag) < 0)	{ return -1; }
+	while ('|' == **pSyntax) {
+		++*pSyntax;
+		if (crossline_gram_seq (pGrammar, pSyntax, &frag) < 0)	{ return -1; }
+		if ((split = crossline_gram_state (pGrammar, CROSS_GRAM_SPLIT, 0, pFrag->start, frag.start)) < 0)
+			{ return -1; }
+		if (end < 0) {
+			if ((end = crossline_gram_state (pGrammar, CROSS_GRAM_NOP, 0, -1, -1)) < 0)	{ return -1; }
+			pGrammar->states[pFrag->end].out = end;
+		}
+		pGrammar->states[frag.end].out = end;
+		pFrag->start	= split;
+		pFrag->end		= end;
+	}
+	return 0;
+}
+
+// Add states reachable from id without token to current set, skip states visited in this step.
+static int crossline_gram_closure (crossline_grammar_t *pGrammar, int id)
+{
+	while (id >= 0) {
+		if (pGrammar->marks[id] == pGrammar->mark_gen)	{ return 0; }
+		pGrammar->marks[id] = pGrammar->mark_gen;
+		switch (pGrammar->states[id].type) {
+		case CROSS_GRAM_SPLIT:
+			if (crossline_gram_closure (pGrammar, pGrammar->states[id].out) < 0)	{ return -1; }
+			id = pGrammar->states[id].out1;
+			break;
+		case CROSS_GRAM_NOP:
+			id = pGrammar->states[id].out;
+			break;
+		default:
+			if (crossline_array_grow ((void**)&pGrammar->sets, &pGrammar->set_max, pGrammar->set_num + 1, sizeof(uint32_t)) < 0)
+				{ return -1; }
+			pGrammar->sets[pGrammar->set_num++] = id;
+			return 0;
+		}
+	}
+	return 0;
+}
+
+// Start new closure step and make sure all states have visit marks.
+static int crossline_gram_step_begin (crossline_grammar_t *pGrammar)
+{
+	uint32_t max = pGrammar->mark_max;
+	if (crossline_array_grow ((void**)&pGrammar->marks, &pGrammar->mark_max, pGrammar->state_num, sizeof(uint32_t)) < 0)
+		{ return -1; }
+	if (pGrammar->mark_max > max)
+		{ memset (&pGrammar->marks[max], 0, (pGrammar->mark_max - max) * sizeof(uint32_t)); }
+	pGrammar->mark_gen++;
+	return 0;
+}
+
+static int crossline_gram_level_push (crossline_grammar_t *pGrammar, uint32_t set_off, uint32_t tok_end)
+{
+	crossline_gram_level_t *level;
+	if (crossline_array_grow ((void**)&pGrammar->levels, &pGrammar->level_max, pGrammar->level_num + 1, sizeof(*level)) < 0)
+		{ return -1; }
+	level = &pGrammar->levels[pGrammar->level_num++];
+	level->set_off	= set_off;
+	level->set_num	= pGrammar->set_num - set_off;
+	level->tok_end	= tok_end;
+	return 0;
+}
+
+// Move state set of last level over finished token.
+static int crossline_gram_step (crossline_grammar_t *pGrammar, const char *token, uint32_t len, uint32_t tok_end)
+{
+	crossline_gram_level_t *level = &pGrammar->levels[pGrammar->level_num - 1];
+	crossline_gram_state_t *state;
+	uint32_t i, set_off = pGrammar->set_num, set_end = level->set_off + level->set_num;
+	int found = 0, pass;
+
+	if (crossline_gram_step_begin (pGrammar) < 0)	{ return -1; }
+	for (pass = CROSS_GRAM_KEY; (pass <= CROSS_GRAM_ARG) && !found; ++pass) {
+		for (i = level->set_off; i < set_end; ++i) {
+			state = &pGrammar->states[pGrammar->sets[i]];
+			if (state->type != (uint32_t)pass)	{ continue; }
+			if ((CROSS_GRAM_KEY == pass) && ((len != strlen (&pGrammar->pool[state->str])) || 
+				strncasecmp (token, &pGrammar->pool[state->str], len)))
+				{ continue; }
+			if (crossline_gram_closure (pGrammar, state->out) < 0)	{ return -1; }
+			found = 1;
+		}
+	}
+	return crossline_gram_level_push (pGrammar, set_off, tok_end);
+}
+
+// Add command syntax with optional help, return 0 if OK, -1 if syntax error.
+int crossline_grammar_add (crossline_grammar_t *pGrammar, const char *syntax, const char *help)
+{
+	crossline_gram_frag_t frag;
+	uint32_t state_num, pool_len, i, set_off, help_off = 0;
+	int match;
+
+	if ((NULL == pGrammar) || (NULL == syntax))	{ return -1; }
+	state_num	= pGrammar->state_num;
+	pool_len	= pGrammar->pool_len;
+	pGrammar->level_num = 0; // rebuild parse cache
+	if ((crossline_gram_alt (pGrammar, &syntax, &frag) < 0) || ('\0' != *syntax) ||
+		((match = crossline_gram_state (pGrammar, CROSS_GRAM_MATCH, 0, -1, -1)) < 0) ||
+		(crossline_array_grow ((void**)&pGrammar->rules, &pGrammar->rule_max, pGrammar->rule_num + 1, sizeof(uint32_t)) < 0) ||
+		((NULL != help) && ('\0' != *help) && (0 == (help_off = crossline_gram_str (pGrammar, help, (int)strlen(help))))) ||
+		(crossline_gram_step_begin (pGrammar) < 0)) {
+		pGrammar->state_num	= state_num;
+		pGrammar->pool_len	= pool_len;
+		return -1;
+	}
+	pGrammar->states[frag.end].out = match;
+	pGrammar->rules[pGrammar->rule_num++] = frag.start;
+	// Help is shown with command keywords
+	set_off = pGrammar->set_num = 0;
+	if (help_off && (0 == crossline_gram_closure (pGrammar, frag.start))) {
+		for (i = set_off; i < pGrammar->set_num; ++i) {
+			if (CROSS_GRAM_KEY == pGrammar->states[pGrammar->sets[i]].type)
+				{ pGrammar->states[pGrammar->sets[i]].help = help_off; }
+		}
+	}
+	return 0;
+}
+
+// Add placeholder type, <name> in syntax shows hint and gets values from provider (optional).
+int crossline_grammar_type_add (crossline_grammar_t *pGrammar, const char *name, const char *hint, 
+									crossline_color_e color, crossline_grammar_provider provider, void *arg)
+{
+	crossline_gram_type_t *type;
+	uint32_t name_off, hint_off = 0;
+
+	if ((NULL == pGrammar) || (NULL == name))	{ return -1; }
+	if ((crossline_array_grow ((void**)&pGrammar->types, &pGrammar->type_max, pGrammar->type_num + 1, sizeof(*type)) < 0) ||
+		(0 == (name_off = crossline_gram_str (pGrammar, name, (int)strlen(name)))) ||
+		((NULL != hint) && (0 == (hint_off = crossline_gram_str (pGrammar, hint, (int)strlen(hint))))))
+		{ return -1; }
+	type = &pGrammar->types[pGrammar->type_num++];
+	type->name		= name_off;
+	type->hint		= hint_off;
+	type->color		= color;
+	type->provider	= provider;
+	type->arg		= arg;
+	return 0;
+}
+
+// Add expected keywords, placeholder hints and values for the last token of buf, return number of words added.
+int crossline_grammar_complete (crossline_grammar_t *pGrammar, const char *buf, crossline_completions_t *pCompletions)
+{
+	crossline_gram_level_t *level;
+	crossline_gram_state_t *state;
+	crossline_gram_type_t *type;
+	uint32_t len, same, i, j, k, pos, start, set_end;
+	int num, hint_len = 0;
+	const char *word, *hint;
+	char hints[256];
+	crossline_color_e hint_color = CROSSLINE_COLOR_DEFAULT;
+
+	if ((NULL == pGrammar) || (NULL == buf) || (NULL == pCompletions))	{ return 0; }
+	num = pCompletions->num;
+	len = (uint32_t)strlen (buf);
+	if (0 == pGrammar->level_num) {
+		pGrammar->set_num = 0;
+		if (crossline_gram_step_begin (pGrammar) < 0)	{ return 0; }
+		for (i = 0; i < pGrammar->rule_num; ++i) {
+			if (crossline_gram_closure (pGrammar, pGrammar->rules[i]) < 0)	{ return 0; }
+		}
+		if (crossline_gram_level_push (pGrammar, 0, 0) < 0)	{ return 0; }
+		if (NULL != pGrammar->text)	{ pGrammar->text[0] = '\0'; }
+	}
+	// Keep levels whose token and following space are unchanged
+	for (same = 0; (same < len) && (NULL != pGrammar->text) && (pGrammar->text[same] == buf[same]); ++same)	;
+	while ((pGrammar->level_num > 1) && (pGrammar->levels[pGrammar->level_num - 1].tok_end >= same))
+		{ pGrammar->level_num--; }
+	level = &pGrammar->levels[pGrammar->level_num - 1];
+	pGrammar->set_num = level->set_off + level->set_num;
+	if (crossline_array_grow ((void**)&pGrammar->text, &pGrammar->text_max, len + 1, 1) < 0) {
+		pGrammar->level_num = 0;
+		return 0;
+	}
+	memcpy (pGrammar->text, buf, len + 1);
+
+	for (pos = level->tok_end; ; ) {
+		while ((pos < len) && isspace((unsigned char)buf[pos]))	{ pos++; }
+		for (start = pos; (pos < len) && !isspace((unsigned char)buf[pos]); ++pos)	;
+		if (pos >= len)	{ break; } // last token is not finished
+		if (crossline_gram_step (pGrammar, &buf[start], pos - start, pos) < 0) {
+			pGrammar->level_num = 0;
+			return 0;
+		}
+	}
+
+	level = &pGrammar->levels[pGrammar->level_num - 1];
+	set_end = level->set_off + level->set_num;
+	for (i = level->set_off; i < set_end; ++i) {
+		state = &pGrammar->states[pGrammar->sets[i]];
+		word = &pGrammar->pool[state->str];
+		for (j = level->set_off; j < i; ++j) {
+			if ((pGrammar->states[pGrammar->sets[j]].type == state->type) && 
+				!strcasecmp (word, &pGrammar->pool[pGrammar->states[pGrammar->sets[j]].str]))
+				{ break; }
+		}
+		if (j < i)	{ continue; } // shown already
+		if (CROSS_GRAM_KEY == state->type) {
+			if (!strncasecmp (word, &buf[start], len - start)) {
+				crossline_completion_add_static_color (pCompletions, word, state->help ? pGrammar->cmd_color : pGrammar->key_color, 
+														state->help ? &pGrammar->pool[state->help] : NULL, pGrammar->help_color);
+			}
+		} else if (CROSS_GRAM_ARG == state->type) {
+			for (k = 0; (k < pGrammar->type_num) && strcmp (word, &pGrammar->pool[pGrammar->types[k].name]); ++k)	;
+			type = (k < pGrammar->type_num) ? &pGrammar->types[k] : NULL;
+			hint = ((NULL != type) && type->hint) ? &pGrammar->pool[type->hint] : word;
+			if (0 == hint_len)	{ hint_color = (NULL != type) ? type->color : CROSSLINE_COLOR_DEFAULT; }
+			hint_len += snprintf (&hints[hint_len], sizeof(hints) - hint_len, "%s%s", hint_len ? " | " : "", hint);
+			if (hint_len >= (int)sizeof(hints))	{ hint_len = sizeof(hints) - 1; }
+			if ((NULL != type) && (NULL != type->provider))
+				{ type->provider (&buf[start], pCompletions, type->arg); }
+		}
+	}
+	if (hint_len > 0) {
+		crossline_hints_set_color (pCompletions, hints, hint_color);
+		if (start == len)	{ pCompletions->common_len = 0; } // value is expected too, don't pick keyword
+	}
+	return pCompletions->num - num;
+}
+
+// Register grammar to complete on TAB besides completion callback, NULL to unregister.
+void crossline_grammar_register (crossline_grammar_t *pGrammar)
+{
+	s_completion_grammar = pGrammar;
+}
+
+/*****************************************************************************/
+
+int crossline_paging_set (int enable)
+{
+	int prev = s_paging_print_line >=0;
+	crossline_paging_flush ();
+	s_paging_print_line = enable ? 0 : -1;
+	return prev;
+}
+
+// Check whether paging check of this line will stop to wait key, so buffered output must be written before.
+static int crossline_paging_full (int line_len)
+{
+	int rows, cols;
+	if ((s_paging_print_line < 0) || !isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))	{ return 0; }
+	crossline_screen_get (&rows, &cols);
+	return s_paging_print_line + (line_len + cols - 1) / cols >= rows - 1;
+}
+
+// Show paging hints and wait key, return 1 means quit.
+static int crossline_paging_wait (void)
+{
+	char *paging_hints = "*** Press <Space> or <Enter> to continue . . .";
+	int	i, ch, len = (int)strlen(paging_hints);
+
+	printf ("%s", paging_hints);
+	ch = crossline_getch();
+	if (0 == ch) { crossline_getch(); }	// some terminal server may send 0 after Enter
+	// clear paging hints
+	for (i = 0; i < len; ++i) { printf ("\b"); }
+	for (i = 0; i < len; ++i) { printf (" ");  }
+	for (i = 0; i < len; ++i) { printf ("\b"); }
+	s_paging_print_line = 0;
+	if ((' ' != ch) && (KEY_ENTER != ch) && (KEY_ENTER2 != ch)) {
+		return 1; 
+	}
+	return 0;
+}
+
+int crossline_paging_check (int line_len)
+{
+	int	rows, cols;
+
+	if ((s_paging_print_line < 0) || !isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))	{ return 0; }
+	crossline_screen_get (&rows, &cols);
+	s_paging_print_line += (line_len + cols - 1) / cols;
+	if (s_paging_print_line >= (rows - 1))	{ return crossline_paging_wait (); }
+	return 0;
+}
+
+/* Paging writer counts rows like terminal: chars wrap when they don't fit row, wide chars take 2 cells, 
+ * escape sequences take none. It's checked once whether to page, so output to pipe or file is only copied.
+ */
+
+// A row is done, write output before pos and wait key if page is full, return 1 means quit.
+static int crossline_paging_row (int pos)
+{
+	if (++s_paging_print_line < s_paging_out.rows - 1)	{ return 0; }
+	fwrite (s_paging_out.buf, 1, pos, stdout);
+	memmove (s_paging_out.buf, &s_paging_out.buf[pos], s_paging_out.len - pos);
+	s_paging_out.len -= pos;
+	if (crossline_paging_wait ()) {
+		s_paging_out.quit	= 1;
+		s_paging_out.len	= 0;
+		return 1;
+	}
+	crossline_screen_get (&s_paging_out.rows, &s_paging_out.cols); // may be resized
+	return 0;
+}
+
+int crossline_paging_write (const char *text, int len)
+{
+	int i, w, start = 0;
+	unsigned char ch;
+
+	if (s_paging_out.quit)	{ return 1; }
+	if (len < 0)	{ len = (int)strlen (text); }
+	if (s_paging_out.tty < 0) {
+		fflush (stdout); // output printed before goes first
+		s_paging_out.tty = (s_paging_print_line >= 0) && isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+		if (s_paging_out.tty)	{ crossline_screen_get (&s_paging_out.rows, &s_paging_out.cols); }
+	}
+	if (!s_paging_out.tty) {
+		if (len > CROSS_PAGING_BUF_LEN - s_paging_out.len) {
+			crossline_out_flush (s_paging_out.buf, &s_paging_out.len);
+			if (len >= CROSS_PAGING_BUF_LEN)	{ fwrite (text, 1, len, stdout); return 0; }
+		}
+		memcpy (&s_paging_out.buf[s_paging_out.len], text, len);
+		s_paging_out.len += len;
+		return 0;
+	}
+
+	for (i = 0; i < len; ++i) {
+		ch = (unsigned char)text[i];
+		if (!s_paging_out.need && !s_paging_out.esc) {
+			// keep room for a whole char and a newline inserted before it
+			if (s_paging_out.len > CROSS_PAGING_BUF_LEN - 8)	{ crossline_out_flush (s_paging_out.buf, &s_paging_out.len); }
+			start = s_paging_out.len;
+		}
+		s_paging_out.buf[s_paging_out.len++] = ch;
+		if (s_paging_out.esc) {
+			if (1 == s_paging_out.esc)			{ s_paging_out.esc = ('[' == ch) ? 2 : 0; }
+			else if ((ch >= 0x40) && (ch <= 0x7E))	{ s_paging_out.esc = 0; }
+			continue;
+		}
+		w = 0;
+		if (s_paging_out.need && (0x80 == (ch & 0xC0))) {
+			s_paging_out.code = (s_paging_out.code << 6) | (ch & 0x3F);
+			if (--s_paging_out.need > 0)	{ continue; }
+			w = crossline_char_width (s_paging_out.code);
+		} else {
+			if (s_paging_out.need)	{ start = s_paging_out.len - 1; } // broken char
+			s_paging_out.need = 0;
+			if ('\n' == ch) {
+				s_paging_out.col = 0;
+				if (crossline_paging_row (s_paging_out.len))	{ return 1; }
+			} else if ('\r' == ch) {
+				s_paging_out.col = 0;
+			} else if ('\b' == ch) {
+				if (s_paging_out.col > 0)	{ s_paging_out.col--; }
+			} else if ('\t' == ch) { // tab stops at last column
+				s_paging_out.col += 8 - s_paging_out.col % 8;
+				if (s_paging_out.col >= s_paging_out.cols)	{ s_paging_out.col = s_paging_out.cols - 1; }
+			} else if ('\x1b' == ch) {
+				s_paging_out.esc = 1;
+			} else if ((ch >= 0xC0) && (ch < 0xF8)) {
+				s_paging_out.need = (ch >= 0xF0) ? 3 : ((ch >= 0xE0) ? 2 : 1);
+				s_paging_out.code = ch & (0x3F >> s_paging_out.need);
+			} else if ((ch >= 0x20) && (0x7F != ch)) {
+				w = 1;
+			}
+		}
+		if (w <= 0)	{ continue; }
+		if (s_paging_out.col + w > s_paging_out.cols) { // wrap to next row
+			s_paging_out.col = 0;
+			if (s_paging_print_line + 1 >= s_paging_out.rows - 1) { // page ends, break row before char
+				memmove (&s_paging_out.buf[start + 1], &s_paging_out.buf[start], s_paging_out.len - start);
+				s_paging_out.buf[start] = '\n';
+				s_paging_out.len++;
+				start++;
+			}
+			if (crossline_paging_row (start))	{ return 1; }
+		}
+		s_paging_out.col += w;
+	}
+	return 0;
+}
+
+int crossline_paging_printf (const char *fmt, ...)
+{
+	char buf[1024], *text = buf;
+	int len, ret;
+	va_list ap;
+
+	va_start (ap, fmt);
+	len = vsnprintf (buf, sizeof(buf), fmt, ap);
+	va_end (ap);
+	if (len < 0)	{ return 0; }
+	if ((len >= (int)sizeof(buf)) && (NULL != (text = (char*)malloc (len + 1)))) {
+		va_start (ap, fmt);
+		vsnprintf (text, len + 1, fmt, ap);
+		va_end (ap);
+	}
+	if (NULL == text)	{ text = buf; len = (int)sizeof(buf) - 1; }
+	ret = crossline_paging_write (text, len);
+	if (text != buf)	{ free (text); }
+	return ret;
+}
+
+void crossline_paging_flush (void)
+{
+	crossline_out_flush (s_paging_out.buf, &s_paging_out.len);
+	fflush (stdout);
+	s_paging_out.tty	= -1;
+	s_paging_out.col	= 0;
+	s_paging_out.esc	= 0;
+	s_paging_out.need	= 0;
+	s_paging_out.quit	= 0;
+}
+
+// Write SGR sequence of color to buf (at least 16 bytes), return length.
+static int crossline_sgr (char *buf, crossline_color_e color)
+{
+	int len = sprintf (buf, "\033[0");
+	if (CROSSLINE_FGCOLOR_DEFAULT != (color&CROSSLINE_FGCOLOR_MASK)) 
+		{ len += sprintf (&buf[len], ";%d", 29 + (color&CROSSLINE_FGCOLOR_MASK) + ((color&CROSSLINE_FGCOLOR_BRIGHT)?60:0)); }
+	if (CROSSLINE_BGCOLOR_DEFAULT != (color&CROSSLINE_BGCOLOR_MASK)) 
+		{ len += sprintf (&buf[len], ";%d", 39 + ((color&CROSSLINE_BGCOLOR_MASK)>>8) + ((color&CROSSLINE_BGCOLOR_BRIGHT)?60:0)); }
+	if (color & CROSSLINE_UNDERLINE)	{ len += sprintf (&buf[len], ";4"); }
+	return len + sprintf (&buf[len], "m");
+}
+
+// Append len bytes (spaces if str is NULL) to line, line is cut at size and always ends with '\0'.
+static void crossline_line_add (char *buf, int *pLen, int size, const char *str, int len)
+{
+	if (len > size - 1 - *pLen)	{ len = size - 1 - *pLen; }
+	if (len <= 0)	{ return; }
+	if (NULL != str)	{ memcpy (&buf[*pLen], str, len); }
+	else				{ memset (&buf[*pLen], ' ', len); }
+	*pLen += len;
+	buf[*pLen] = '\0';
+}
+
+/* Print text with SGR color sequences, sequences are dropped if output is not terminal, and they're
+ * changed to console colors for Windows.
+ */
+static void crossline_sgr_print (const char *text)
+{
+	int len, code;
+	char *end;
+	crossline_color_e color;
+
+	while ('\0' != *text) {
+		for (len = 0; ('\0' != text[len]) && ('\x1b' != text[len]); ++len)	;
+		printf ("%.*s", len, text);
+		if ('\0' == text[len])	{ break; }
+		text += len;
+		for (len = 2; ('\0' != text[len]) && ((text[len] < 0x40) || (text[len] > 0x7E)); ++len)	;
+		len += ('\0' != text[len]) ? 1 : 0;
+		if (!s_crossline_win) {
+			if (isatty (STDOUT_FILENO))	{ printf ("%.*s", len, text); }
+		} else if ('m' == text[len-1]) {
+			for (color = CROSSLINE_COLOR_DEFAULT, end = (char*)text + 2; end < text + len - 1; ++end) {
+				code = (int)strtol (end, &end, 10);
+				if ((code >= 30) && (code <= 37))			{ color = (color & ~CROSSLINE_FGCOLOR_MASK) | (code - 29); }
+				else if ((code >= 90) && (code <= 97))		{ color = (color & ~CROSSLINE_FGCOLOR_MASK) | (code - 89) | CROSSLINE_FGCOLOR_BRIGHT; }
+				else if ((code >= 40) && (code <= 47))		{ color = (color & ~CROSSLINE_BGCOLOR_MASK) | ((code - 39) << 8); }
+				else if ((code >= 100) && (code <= 107))	{ color = (color & ~CROSSLINE_BGCOLOR_MASK) | ((code - 99) << 8) | CROSSLINE_BGCOLOR_BRIGHT; }
+				else if (4 == code)	{ color |= CROSSLINE_UNDERLINE; }
+				else if (0 == code)	{ color = CROSSLINE_COLOR_DEFAULT; }
+			}
+			crossline_color_set (color);
+		}
+		text += len;
+	}
+}
+
+void crossline_pager_show (const char *title, int num, crossline_pager_callback pCbFunc, void *arg)
+{
+	char line[CROSS_PAGER_LINE_LEN];
+	const char *text;
+	int i;
+
+	if ((NULL == pCbFunc) || crossline_pager_run (title, num, pCbFunc, arg))	{ return; }
+	for (i = 0; i < num; ++i) {
+		if (NULL == (text = pCbFunc (i, line, sizeof(line), arg)))	{ break; }
+		crossline_sgr_print (text);
+		printf ("\n");
+		if (crossline_paging_check (crossline_ansi_cells (text, (int)strlen (text), 0) + 1))
+			{ break; }
+	}
+}
+
+/*****************************************************************************/
+
+void  crossline_prompt_color_set (crossline_color_e color)
+{
+	s_prompt_color	= color;
+}
+
+void crossline_screen_clear ()
+{
+	int ret = system (s_crossline_win ? "cls" : "clear");
+	(void) ret;
+}
+
+#ifdef _WIN32	// Windows
+
+static uint64_t crossline_time_ms (void)
+{
+	return GetTickCount64 ();
+}
+
+// Wait key input for timeout_ms, return 1 if key is ready.
+static int crossline_input_wait (int timeout_ms)
+{
+	uint64_t end = crossline_time_ms () + timeout_ms;
+	fflush (stdout);
+	while (!_kbhit ()) {
+		if ((timeout_ms >= 0) && (crossline_time_ms () >= end))	{ return 0; }
+		if ((NULL != s_above.head) && !s_above.hold)	{ return 0; }
+		Sleep (10);
+	}
+	return 1;
+}
+
+int crossline_getch (void)
+{
+	fflush (stdout);
+	return _getch();
+}
+void crossline_screen_get (int *pRows, int *pCols)
+{
+	CONSOLE_SCREEN_BUFFER_INFO inf;
 	GetConsoleScreenBufferInfo (GetStdHandle(STD_OUTPUT_HANDLE), &inf);
 	*pCols = inf.srWindow.Right - inf.srWindow.Left + 1;
 	*pRows = inf.srWindow.Bottom - inf.srWindow.Top + 1;
@@ -591,9 +3567,43 @@ void crossline_color_set (crossline_color_e color)
 
 #else // Linux
 
+static uint64_t crossline_time_ms (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Wait key input for timeout_ms, return 1 if key is ready.
+static int crossline_input_wait (int timeout_ms)
+{
+	int ret;
+	char drain[64];
+	struct termios old_term, cur_term;
+	struct pollfd pfd[2];
+	fflush (stdout);
+	if (tcgetattr(STDIN_FILENO, &old_term) < 0)	{ return 0; }
+	cur_term = old_term;
+	cur_term.c_lflag &= ~(ICANON | ECHO | ISIG); // same with crossline_getch, so key is ready without Enter
+	cur_term.c_cc[VMIN] = 1;
+	cur_term.c_cc[VTIME] = 0;
+	tcsetattr (STDIN_FILENO, TCSANOW, &cur_term);
+	pfd[0].fd		= STDIN_FILENO;
+	pfd[0].events	= POLLIN;
+	pfd[1].fd		= s_above.hold ? -1 : s_above.pipe[0]; // wake for output above prompt
+	pfd[1].events	= POLLIN;
+	pfd[0].revents	= pfd[1].revents = 0;
+	ret = poll (pfd, 2, timeout_ms);
+	tcsetattr (STDIN_FILENO, TCSANOW, &old_term);
+	if ((ret > 0) && (pfd[1].revents & POLLIN)) {
+		while (read (s_above.pipe[0], drain, sizeof(drain)) > 0)	;
+	}
+	return (ret > 0) && (pfd[0].revents & POLLIN);
+}
+
 int crossline_getch ()
 {
-	char ch = 0;
+	unsigned char ch = 0;
 	struct termios old_term, cur_term;
 	fflush (stdout);
 	if (tcgetattr(STDIN_FILENO, &old_term) < 0)	{ perror("tcsetattr"); }
@@ -661,11 +3671,20 @@ void crossline_color_set (crossline_color_e color)
 
 /*****************************************************************************/
 
+static const char* crossline_help_line (int idx, char *buf, int size, void *arg)
+{
+	(void)buf;
+	(void)size;
+	return ((char**)arg)[idx];
+}
+
 static void crossline_show_help (int show_search)
 {
 	int	i;
 	char **help = show_search ? s_search_help : s_crossline_help;
  	printf (" \b\n");
+	for (i = 0; NULL != help[i]; ++i)	;
+	if (crossline_pager_run ("Help", i, crossline_help_line, help))	{ return; }
 	for (i = 0; NULL != help[i]; ++i) {
 		printf ("%s\n", help[i]);
 		if (crossline_paging_check ((int)strlen(help[i])+1))
@@ -673,31 +3692,6 @@ static void crossline_show_help (int show_search)
 	}
 }
 
-static void str_to_lower (char *str)
-{
-	for (; '\0' != *str; ++str)
-		{ *str = (char)tolower (*str); }
-}
-
-// Match including(no prefix) and excluding(with prefix: '-') patterns.
-static int crossline_match_patterns (const char *str, char *word[], int num)
-{
-	int i;
-	char buf[CROSS_HISTORY_BUF_LEN];
-
-	strncpy (buf, str, sizeof(buf) - 1);
-	buf[sizeof(buf) - 1] = '\0';
-	str_to_lower (buf);
-	for (i = 0; i < num; ++i) {
-		if ('-' == word[i][0]) {
-			if (NULL != strstr (buf, &word[i][1]))
-				{ return 0; }
-		} else if (NULL == strstr (buf, word[i]))
-			{ return 0; }
-	}
-	return 1;
-}
-
 // Split pattern string to individual pattern list, handle composite words embraced with " ".
 static int crossline_split_patterns (char *patterns, char *pat_list[], int max)
 {
@@ -723,23 +3717,475 @@ static int crossline_split_patterns (char *patterns, char *pat_list[], int max)
 		}
 	}
 	for (i = 0; i < num; ++i)
-		{ str_to_lower (pat_list[i]); }
+		{ crossline_str_fold (pat_list[i], pat_list[i]); }
 	return num;
 }
 
-// If patterns is not NULL, will filter history.
-// If sel_id > 0, return the real id+1 in history buf, else return history number dumped.
-static int crossline_history_dump (FILE *file, int print_id, char *patterns, int sel_id, int paging)
+/*****************************************************************************/
+
+/* History search patterns are compiled once per search:
+ *   literal patterns are merged to one Aho-Corasick automaton,
+ *   anchored globs and regexes are merged to one Thompson NFA (no backtracking),
+ * then each history line is scanned once and every hit pattern is recorded in a bit mask.
+ */
+
+enum {
+	CROSS_RE_CHAR, CROSS_RE_ANY, CROSS_RE_CLASS, CROSS_RE_BOL, CROSS_RE_EOL,
+	CROSS_RE_CAT, CROSS_RE_ALT, CROSS_RE_STAR, CROSS_RE_PLUS, CROSS_RE_QUEST, CROSS_RE_EMPTY,
+	CROSS_NFA_SPLIT, CROSS_NFA_JMP, CROSS_NFA_MATCH
+};
+
+typedef struct crossline_re_t {
+	int		type, val; // val is char for CROSS_RE_CHAR or class index for CROSS_RE_CLASS
+	struct crossline_re_t *left, *right;
+} crossline_re_t;
+
+typedef struct crossline_nfa_t {
+	int		op, val; // val is char, class index or pattern index for CROSS_NFA_MATCH
+	int		x, y;	 // jump targets
+} crossline_nfa_t;
+
+typedef struct crossline_matcher_t {
+	uint32_t	include, exclude;	// Including and excluding pattern bit masks
+	// Aho-Corasick DFA, bytes not in literals share class 0
+	int			ac_classes;
+	uint8_t		ac_class[256];
+	int			*ac_next;
+	uint32_t	*ac_out;
+	// Thompson NFA for all globs and regexes, starts list holds start pc of each pattern
+	int			nfa_num, nfa_max, start_num, cls_num, gen;
+	crossline_nfa_t *nfa;
+	uint8_t		(*cls)[32];
+	int			*starts, *mark, *list[2];
+} crossline_matcher_t;
+
+typedef struct crossline_re_parse_t {
+	const char		*pch, *end;
+	crossline_re_t	*pool;
+	int				used;
+	crossline_matcher_t	*matcher;
+} crossline_re_parse_t;
+
+static crossline_re_t* crossline_re_node (crossline_re_parse_t *p, int type, int val, crossline_re_t *left, crossline_re_t *right)
 {
-	uint32_t i;
-	int		id = 0, num=0;
-	char	*pat_list[CROSS_HIS_MATCH_PAT_NUM], *history;
+	crossline_re_t *node = &p->pool[p->used++];
+	node->type = type;	node->val = val;
+	node->left = left;	node->right = right;
+	return node;
+}
+
+static crossline_re_t* crossline_re_alt (crossline_re_parse_t *p);
+
+static int crossline_re_class (crossline_re_parse_t *p)
+{
+	int i, neg = 0, ch, ch2;
+	uint8_t *bits = p->matcher->cls[p->matcher->cls_num];
+
+	memset (bits, 0, 32);
+	if ((p->pch < p->end) && ('^' == *p->pch)) { neg = 1; p->pch++; }
+	for (i = 0; (p->pch < p->end) && ((']' != *p->pch) || !i); ++i) {
+		if (('\\' == *p->pch) && (p->pch+1 < p->end))	{ p->pch++; }
+		ch = ch2 = (uint8_t)*p->pch++;
+		if ((p->pch+1 < p->end) && ('-' == p->pch[0]) && (']' != p->pch[1])) {
+			p->pch++;
+			if (('\\' == *p->pch) && (p->pch+1 < p->end))	{ p->pch++; }
+			ch2 = (uint8_t)*p->pch++;
+		}
+		for (; ch <= ch2; ++ch)	{ bits[ch>>3] |= (uint8_t)(1 << (ch&7)); }
+	}
+	if (p->pch >= p->end)	{ return -1; } // missing ']'
+	p->pch++;
+	if (neg) {
+		for (i = 0; i < 32; ++i)	{ bits[i] = (uint8_t)~bits[i]; }
+	}
+	return p->matcher->cls_num++;
+}
 
+static crossline_re_t* crossline_re_atom (crossline_re_parse_t *p)
+{
+	int ch = (uint8_t)*p->pch++;
+	crossline_re_t *node;
+
+	switch (ch) {
+	case '(':
+		if (NULL == (node = crossline_re_alt (p)))	{ return NULL; }
+		if ((p->pch >= p->end) || (')' != *p->pch))	{ return NULL; }
+		p->pch++;
+		return node;
+	case '[':
+		if ((ch = crossline_re_class (p)) < 0)	{ return NULL; }
+		return crossline_re_node (p, CROSS_RE_CLASS, ch, NULL, NULL);
+	case '.':	return crossline_re_node (p, CROSS_RE_ANY, 0, NULL, NULL);
+	case '^':	return crossline_re_node (p, CROSS_RE_BOL, 0, NULL, NULL);
+	case '$':	return crossline_re_node (p, CROSS_RE_EOL, 0, NULL, NULL);
+	case '*': case '+': case '?': case ')':
+		return NULL;
+	case '\\':
+		if (p->pch >= p->end)	{ return NULL; }
+		ch = (uint8_t)*p->pch++;
+	}
+	return crossline_re_node (p, CROSS_RE_CHAR, ch, NULL, NULL);
+}
+
+static crossline_re_t* crossline_re_cat (crossline_re_parse_t *p)
+{
+	crossline_re_t *node = NULL, *atom;
+	int type;
+
+	while ((p->pch < p->end) && ('|' != *p->pch) && (')' != *p->pch)) {
+		if (NULL == (atom = crossline_re_atom (p)))	{ return NULL; }
+		while ((p->pch < p->end) && (('*' == *p->pch) || ('+' == *p->pch) || ('?' == *p->pch))) {
+			type = ('*' == *p->pch) ? CROSS_RE_STAR : (('+' == *p->pch) ? CROSS_RE_PLUS : CROSS_RE_QUEST);
+			atom = crossline_re_node (p, type, 0, atom, NULL);
+			p->pch++;
+		}
+		node = (NULL == node) ? atom : crossline_re_node (p, CROSS_RE_CAT, 0, node, atom);
+	}
+	return (NULL == node) ? crossline_re_node (p, CROSS_RE_EMPTY, 0, NULL, NULL) : node;
+}
+
+static crossline_re_t* crossline_re_alt (crossline_re_parse_t *p)
+{
+	crossline_re_t *node = crossline_re_cat (p), *right;
+
+	while ((NULL != node) && (p->pch < p->end) && ('|' == *p->pch)) {
+		p->pch++;
+		if (NULL == (right = crossline_re_cat (p)))	{ return NULL; }
+		node = crossline_re_node (p, CROSS_RE_ALT, 0, node, right);
+	}
+	return node;
+}
+
+// Anchored glob: '*' matches any string, '?' matches any character, leading '^' and trailing '$' are anchors.
+static crossline_re_t* crossline_re_glob (crossline_re_parse_t *p)
+{
+	crossline_re_t *node = NULL, *atom;
+	int ch;
+
+	for (; p->pch < p->end; p->pch++) {
+		ch = (uint8_t)*p->pch;
+		if (('^' == ch) && (NULL == node)) {
+			atom = crossline_re_node (p, CROSS_RE_BOL, 0, NULL, NULL);
+		} else if (('$' == ch) && (p->pch+1 == p->end)) {
+			atom = crossline_re_node (p, CROSS_RE_EOL, 0, NULL, NULL);
+		} else if ('*' == ch) {
+			atom = crossline_re_node (p, CROSS_RE_STAR, 0, crossline_re_node (p, CROSS_RE_ANY, 0, NULL, NULL), NULL);
+		} else if ('?' == ch) {
+			atom = crossline_re_node (p, CROSS_RE_ANY, 0, NULL, NULL);
+		} else {
+			atom = crossline_re_node (p, CROSS_RE_CHAR, ch, NULL, NULL);
+		}
+		node = (NULL == node) ? atom : crossline_re_node (p, CROSS_RE_CAT, 0, node, atom);
+	}
+	return (NULL == node) ? crossline_re_node (p, CROSS_RE_EMPTY, 0, NULL, NULL) : node;
+}
+
+static int crossline_re_count (crossline_re_t *node)
+{
+	switch (node->type) {
+	case CROSS_RE_CAT:		return crossline_re_count (node->left) + crossline_re_count (node->right);
+	case CROSS_RE_ALT:		return 2 + crossline_re_count (node->left) + crossline_re_count (node->right);
+	case CROSS_RE_STAR:		return 2 + crossline_re_count (node->left);
+	case CROSS_RE_PLUS:
+	case CROSS_RE_QUEST:	return 1 + crossline_re_count (node->left);
+	case CROSS_RE_EMPTY:	return 0;
+	}
+	return 1;
+}
+
+static void crossline_re_emit (crossline_matcher_t *m, crossline_re_t *node)
+{
+	int p1, p2;
+	crossline_nfa_t *nfa = m->nfa;
+
+	switch (node->type) {
+	case CROSS_RE_CAT:
+		crossline_re_emit (m, node->left);
+		crossline_re_emit (m, node->right);
+		break;
+	case CROSS_RE_ALT:
+		p1 = m->nfa_num++;
+		nfa[p1].op = CROSS_NFA_SPLIT;
+		nfa[p1].x = m->nfa_num;
+		crossline_re_emit (m, node->left);
+		p2 = m->nfa_num++;
+		nfa[p2].op = CROSS_NFA_JMP;
+		nfa[p1].y = m->nfa_num;
+		crossline_re_emit (m, node->right);
+		nfa[p2].x = m->nfa_num;
+		break;
+	case CROSS_RE_QUEST:
+		p1 = m->nfa_num++;
+		nfa[p1].op = CROSS_NFA_SPLIT;
+		nfa[p1].x = m->nfa_num;
+		crossline_re_emit (m, node->left);
+		nfa[p1].y = m->nfa_num;
+		break;
+	case CROSS_RE_STAR:
+		p1 = m->nfa_num++;
+		nfa[p1].op = CROSS_NFA_SPLIT;
+		nfa[p1].x = m->nfa_num;
+		crossline_re_emit (m, node->left);
+		p2 = m->nfa_num++;
+		nfa[p2].op = CROSS_NFA_JMP;
+		nfa[p2].x = p1;
+		nfa[p1].y = m->nfa_num;
+		break;
+	case CROSS_RE_PLUS:
+		p2 = m->nfa_num;
+		crossline_re_emit (m, node->left);
+		p1 = m->nfa_num++;
+		nfa[p1].op = CROSS_NFA_SPLIT;
+		nfa[p1].x = p2;
+		nfa[p1].y = m->nfa_num;
+		break;
+	case CROSS_RE_EMPTY:
+		break;
+	default:
+		p1 = m->nfa_num++;
+		nfa[p1].op = node->type;
+		nfa[p1].val = node->val;
+		break;
+	}
+}
+
+static void crossline_matcher_free (crossline_matcher_t *m)
+{
+	if (NULL != m) {
+		free (m->ac_next);	free (m->ac_out);
+		free (m->nfa);		free (m->cls);
+		free (m->starts);	free (m->mark);
+		free (m->list[0]);	free (m->list[1]);
+		free (m);
+	}
+}
+
+// Build Aho-Corasick DFA for literal patterns, states are numbered in trie order.
+static int crossline_matcher_ac (crossline_matcher_t *m, char *lit[], int lit_id[], int lit_num, int total)
+{
+	int i, c, s, t, num = 1, head = 0, tail = 0, *fail, *queue;
+	const uint8_t *pch;
+
+	for (i = 0; i < lit_num; ++i) {
+		for (pch = (const uint8_t*)lit[i]; '\0' != *pch; ++pch) {
+			if (!m->ac_class[*pch])	{ m->ac_class[*pch] = (uint8_t)m->ac_classes++; }
+		}
+	}
+	m->ac_next	= (int*)malloc (sizeof(int) * (total+1) * m->ac_classes);
+	m->ac_out	= (uint32_t*)calloc (total+1, sizeof(uint32_t));
+	fail		= (int*)calloc (total+1, sizeof(int));
+	queue		= (int*)malloc (sizeof(int) * (total+1));
+	if ((NULL == m->ac_next) || (NULL == m->ac_out) || (NULL == fail) || (NULL == queue)) {
+		free (fail);	free (queue);
+		return -1;
+	}
+	memset (m->ac_next, -1, sizeof(int) * (total+1) * m->ac_classes);
+	for (i = 0; i < lit_num; ++i) { // build trie
+		for (s = 0, pch = (const uint8_t*)lit[i]; '\0' != *pch; ++pch) {
+			c = m->ac_class[*pch];
+			if (m->ac_next[s*m->ac_classes + c] < 0)	{ m->ac_next[s*m->ac_classes + c] = num++; }
+			s = m->ac_next[s*m->ac_classes + c];
+		}
+		m->ac_out[s] |= 1u << lit_id[i];
+	}
+	queue[tail++] = 0;
+	while (head < tail) { // fill failure transitions in BFS order
+		s = queue[head++];
+		for (c = 0; c < m->ac_classes; ++c) {
+			t = m->ac_next[s*m->ac_classes + c];
+			if (t < 0) {
+				m->ac_next[s*m->ac_classes + c] = s ? m->ac_next[fail[s]*m->ac_classes + c] : 0;
+			} else {
+				fail[t] = s ? m->ac_next[fail[s]*m->ac_classes + c] : 0;
+				m->ac_out[t] |= m->ac_out[fail[t]];
+				queue[tail++] = t;
+			}
+		}
+	}
+	free (fail);
+	free (queue);
+	return 0;
+}
+
+// Compile search patterns, return NULL if patterns are invalid.
+static crossline_matcher_t* crossline_matcher_compile (char *patterns)
+{
+	int i, len, num, lit_num = 0, lit_len = 0, re_num = 0, re_len = 0, is_re[CROSS_HIS_MATCH_PAT_NUM];
+	int lit_id[CROSS_HIS_MATCH_PAT_NUM], re_id[CROSS_HIS_MATCH_PAT_NUM];
+	char *pat_list[CROSS_HIS_MATCH_PAT_NUM], *lit[CROSS_HIS_MATCH_PAT_NUM], *re[CROSS_HIS_MATCH_PAT_NUM];
+	crossline_re_t *tree[CROSS_HIS_MATCH_PAT_NUM];
+	crossline_re_parse_t parse = {NULL, NULL, NULL, 0, NULL};
+	crossline_matcher_t *m = (crossline_matcher_t*)calloc (1, sizeof(crossline_matcher_t));
+
+	if (NULL == m)	{ return NULL; }
+	m->ac_classes = 1;
 	num = crossline_split_patterns (patterns, pat_list, CROSS_HIS_MATCH_PAT_NUM);
+	for (i = 0; i < num; ++i) {
+		if ('-' == pat_list[i][0]) {
+			m->exclude |= 1u << i;
+			pat_list[i]++;
+		} else
+			{ m->include |= 1u << i; }
+		len = (int)strlen (pat_list[i]);
+		if ((len > 1) && ('/' == pat_list[i][0]) && ('/' == pat_list[i][len-1])) {
+			is_re[re_num] = 1;
+			pat_list[i][len-1] = '\0';
+			re_id[re_num] = i;	re[re_num++] = pat_list[i] + 1;
+			re_len += len;
+		} else if ((len > 0) && (('^' == pat_list[i][0]) || ('$' == pat_list[i][len-1]))) {
+			is_re[re_num] = 0;
+			re_id[re_num] = i;	re[re_num++] = pat_list[i];
+			re_len += len;
+		} else {
+			lit_id[lit_num] = i;	lit[lit_num++] = pat_list[i];
+			lit_len += len;
+		}
+	}
+	if (crossline_matcher_ac (m, lit, lit_id, lit_num, lit_len) < 0)
+		{ goto error; }
+	if (0 == re_num)	{ return m; }
+
+	// Parse all globs and regexes, then emit them to one NFA program
+	parse.pool		= (crossline_re_t*)malloc (sizeof(crossline_re_t) * (3*re_len + 2*re_num));
+	parse.used		= 0;
+	parse.matcher	= m;
+	m->cls			= (uint8_t(*)[32])malloc (32 * (re_len+1));
+	if ((NULL == parse.pool) || (NULL == m->cls))	{ goto error; }
+	for (i = 0; i < re_num; ++i) {
+		parse.pch = re[i];
+		parse.end = re[i] + strlen (re[i]);
+		tree[i] = is_re[i] ? crossline_re_alt (&parse) : crossline_re_glob (&parse);
+		if ((NULL == tree[i]) || (parse.pch != parse.end))	{ goto error; }
+		m->nfa_max += crossline_re_count (tree[i]) + 1;
+	}
+	m->nfa		= (crossline_nfa_t*)calloc (m->nfa_max, sizeof(crossline_nfa_t));
+	m->mark		= (int*)calloc (m->nfa_max, sizeof(int));
+	m->starts	= (int*)malloc (sizeof(int) * re_num);
+	m->list[0]	= (int*)malloc (sizeof(int) * m->nfa_max);
+	m->list[1]	= (int*)malloc (sizeof(int) * m->nfa_max);
+	if ((NULL == m->nfa) || (NULL == m->mark) || (NULL == m->starts) || (NULL == m->list[0]) || (NULL == m->list[1]))
+		{ goto error; }
+	for (i = 0; i < re_num; ++i) {
+		m->starts[m->start_num++] = m->nfa_num;
+		crossline_re_emit (m, tree[i]);
+		m->nfa[m->nfa_num].op = CROSS_NFA_MATCH;
+		m->nfa[m->nfa_num++].val = re_id[i];
+	}
+	free (parse.pool);
+	return m;
+
+error:
+	free (parse.pool);
+	crossline_matcher_free (m);
+	return NULL;
+}
+
+// Add thread and follow empty transitions, record pattern when reaching match.
+static void crossline_nfa_add (crossline_matcher_t *m, int *list, int *pNum, int pc, int pos, int len, uint32_t *pMask)
+{
+	crossline_nfa_t *ins;
+
+	while (m->mark[pc] != m->gen) {
+		m->mark[pc] = m->gen;
+		ins = &m->nfa[pc];
+		switch (ins->op) {
+		case CROSS_NFA_JMP:		pc = ins->x; break;
+		case CROSS_NFA_SPLIT:
+			crossline_nfa_add (m, list, pNum, ins->x, pos, len, pMask);
+			pc = ins->y;
+			break;
+		case CROSS_RE_BOL:
+			if (0 != pos)	{ return; }
+			pc++;
+			break;
+		case CROSS_RE_EOL:
+			if (len != pos)	{ return; }
+			pc++;
+			break;
+		case CROSS_NFA_MATCH:
+			*pMask |= 1u << ins->val;
+			return;
+		default:
+			list[(*pNum)++] = pc;
+			return;
+		}
+	}
+}
+
+// Scan case folded string once, return 1 if it includes all including patterns and no excluding pattern.
+static int crossline_matcher_match (crossline_matcher_t *m, const char *str)
+{
+	int i, j, pc, state = 0, len = (int)strlen (str), cnum = 0, nnum, *clist = m->list[0], *nlist = m->list[1], *tmp;
+	uint32_t mask = m->ac_out[0];
+	uint8_t ch;
+	crossline_nfa_t *ins;
+
+	if (m->start_num) {
+		m->gen++;
+		for (j = 0; j < m->start_num; ++j)
+			{ crossline_nfa_add (m, clist, &cnum, m->starts[j], 0, len, &mask); }
+	}
+	for (i = 0; (i < len) && !(mask & m->exclude); ++i) {
+		ch = (uint8_t)str[i];
+		state = m->ac_next[state*m->ac_classes + m->ac_class[ch]];
+		mask |= m->ac_out[state];
+		if (0 == m->start_num)	{ continue; }
+		m->gen++;
+		for (nnum = 0, j = 0; j < cnum; ++j) {
+			pc = clist[j];
+			ins = &m->nfa[pc];
+			if (((CROSS_RE_CHAR == ins->op) && (ch == ins->val)) || (CROSS_RE_ANY == ins->op) ||
+				((CROSS_RE_CLASS == ins->op) && (m->cls[ins->val][ch>>3] & (1 << (ch&7)))))
+				{ crossline_nfa_add (m, nlist, &nnum, pc+1, i+1, len, &mask); }
+		}
+		for (j = 0; j < m->start_num; ++j)
+			{ crossline_nfa_add (m, nlist, &nnum, m->starts[j], i+1, len, &mask); }
+		tmp = clist; clist = nlist; nlist = tmp;
+		cnum = nnum;
+	}
+	return ((mask & m->include) == m->include) && !(mask & m->exclude);
+}
+
+// History lines shown in pager, idx is history buf index of each line.
+typedef struct crossline_his_list_t {
+	int		print_id, num;
+	int		idx[CROSS_HISTORY_MAX_LINE];
+} crossline_his_list_t;
+
+static const char* crossline_history_line (int idx, char *buf, int size, void *arg)
+{
+	crossline_his_list_t *list = (crossline_his_list_t*)arg;
+	char *history = s_history_buf[list->idx[idx]];
+
+	if (!list->print_id)	{ return history; }
+	snprintf (buf, size, "%4d  %s", idx + 1, history);
+	return buf;
+}
+
+// If matcher is not NULL, will filter history.
+// If sel_id > 0, return the real id+1 in history buf, else return history number dumped.
+// paging: 0 is no paging, 1 is one-way paging (list stays on screen), 2 shows full-screen pager if list doesn't fit.
+static int crossline_history_dump (FILE *file, int print_id, crossline_matcher_t *matcher, int sel_id, int paging)
+{
+	uint32_t i;
+	int		id = 0;
+	char	*history;
+	crossline_his_list_t list;
+
+	if ((2 == paging) && (sel_id <= 0) && (stdout == file)) { // index matched lines for pager
+		list.print_id	= print_id;
+		list.num		= 0;
+		for (i = s_history_id; i < s_history_id + CROSS_HISTORY_MAX_LINE; ++i) {
+			if (('\0' != s_history_buf[i % CROSS_HISTORY_MAX_LINE][0]) && 
+				((NULL == matcher) || crossline_matcher_match (matcher, s_history_fold[i % CROSS_HISTORY_MAX_LINE])))
+				{ list.idx[list.num++] = i % CROSS_HISTORY_MAX_LINE; }
+		}
+		if (crossline_pager_run ("History", list.num, crossline_history_line, &list))	{ return list.num; }
+	}
 	for (i = s_history_id; i < s_history_id + CROSS_HISTORY_MAX_LINE; ++i) {
 		history = s_history_buf[i % CROSS_HISTORY_MAX_LINE];
 		if ('\0' != history[0]) {
-			if ((NULL != patterns) && !crossline_match_patterns (history, pat_list, num))
+			if ((NULL != matcher) && !crossline_matcher_match (matcher, s_history_fold[i % CROSS_HISTORY_MAX_LINE]))
 				{ continue; }
 			if (sel_id > 0) {
 				if (++id == sel_id)
@@ -761,7 +4207,9 @@ static int crossline_history_dump (FILE *file, int print_id, char *patterns, int
 static int crossline_history_search (char *input)
 {
 	uint32_t his_id = 0, count;
+	int ret = 0;
 	char pattern[CROSS_HISTORY_BUF_LEN], buf[8] = "1";
+	crossline_matcher_t *matcher;
 
 	printf (" \b\n");
 	if (NULL != input) {
@@ -769,144 +4217,982 @@ static int crossline_history_search (char *input)
 		pattern[sizeof(pattern) - 1] = '\0';
 	}
 	// Get search patterns
-	if (NULL == crossline_readline_edit(pattern, sizeof (pattern), "Input Patterns <F1> help: ", (NULL!=input), 1))
+	if (NULL == crossline_readline_text (pattern, sizeof (pattern), "Input Patterns <F1> help: ", (NULL!=input), 1))
 		{ return 0; }
 	strncpy (s_clip_buf, pattern, sizeof(s_clip_buf) - 1);
 	s_clip_buf[sizeof(s_clip_buf) - 1] = '\0';
-	count = crossline_history_dump (stdout, 1, pattern, 0, 1);
-	if (0 == count)	{ return 0; } // Nothing found, just return
+	if (NULL == (matcher = crossline_matcher_compile (pattern))) {
+		printf ("Invalid patterns: %s\n", s_clip_buf);
+		return 0;
+	}
+	count = crossline_history_dump (stdout, 1, matcher, 0, 1);
+	if (0 == count)	{ goto done; } // Nothing found, just return
 	// Get choice
-	if (NULL == crossline_readline_edit (buf, sizeof (buf), "Input history id: ", (1==count), 1))
-		{ return 0; }
+	if (NULL == crossline_readline_text (buf, sizeof (buf), "Input history id: ", (1==count), 1))
+		{ goto done; }
 	his_id = atoi (buf);
 	if (('\0' != buf[0]) && ((his_id > count) || (his_id <= 0))) {
 		printf ("Invalid history id: %s\n", buf);
-		return 0;
+		goto done;
+	}
+	ret = crossline_history_dump (stdout, 1, matcher, his_id, 0);
+done:
+	crossline_matcher_free (matcher);
+	return ret;
+}
+
+// Write buffered output.
+static void crossline_out_flush (char *out, int *pLen)
+{
+	if (*pLen > 0)	{ fwrite (out, 1, *pLen, stdout); }
+	*pLen = 0;
+}
+
+// Append len bytes (spaces if str is NULL) to output buffer, flush it if full.
+static void crossline_out_add (char *out, int *pLen, int size, const char *str, int len)
+{
+	int n;
+	while (len > 0) {
+		if (*pLen >= size)	{ crossline_out_flush (out, pLen); }
+		n = (len < size - *pLen) ? len : size - *pLen;
+		if (NULL != str)	{ memcpy (&out[*pLen], str, n); str += n; }
+		else				{ memset (&out[*pLen], ' ', n); }
+		*pLen += n;
+		len -= n;
+	}
+}
+
+// Completion list layout shown in pager.
+typedef struct crossline_comp_list_t {
+	crossline_completions_t *pCompletions;
+	int		*width, *col_width;
+	int		word_len, with_help, col_num, row_num;
+} crossline_comp_list_t;
+
+// Line of completion list: word with help, or a row of words in multiple columns.
+static const char* crossline_completion_line (int idx, char *buf, int size, void *arg)
+{
+	crossline_comp_list_t *list = (crossline_comp_list_t*)arg;
+	crossline_completion_item_t *item;
+	char sgr[16];
+	int j, id, len = 0;
+
+	buf[0] = '\0';
+	for (j = 0; (j < list->col_num) && ((id = idx + j * list->row_num) < list->pCompletions->num); ++j) {
+		item = &list->pCompletions->items[id];
+		if (j > 0)	{ crossline_line_add (buf, &len, size, NULL, list->col_width[j-1] - list->width[id - list->row_num] + 2); }
+		crossline_line_add (buf, &len, size, sgr, crossline_sgr (sgr, item->color_word));
+		crossline_line_add (buf, &len, size, item->word, (int)strlen (item->word));
+		if (list->with_help) {
+			crossline_line_add (buf, &len, size, NULL, 4 + list->word_len - list->width[id]);
+			crossline_line_add (buf, &len, size, sgr, crossline_sgr (sgr, item->color_help));
+			crossline_line_add (buf, &len, size, item->help, (int)strlen (item->help));
+		}
+		crossline_line_add (buf, &len, size, sgr, crossline_sgr (sgr, CROSSLINE_COLOR_DEFAULT));
+	}
+	return buf;
+}
+
+// Show completions returned by callback.
+static int crossline_show_completions (crossline_completions_t *pCompletions)
+{
+	int i, j, ret = 0, word_len = 0, with_help = 0, rows, cols, col_num, row_num, total, len, out_len = 0;
+	int *width, *col_width;
+	crossline_completion_item_t *item;
+	crossline_color_e color = CROSSLINE_COLOR_DEFAULT;
+	char out[4096];
+	crossline_comp_list_t list;
+
+	if (('\0' != pCompletions->hints[0]) || (pCompletions->num > 0)) {
+		printf (" \b\n");
+		ret = 1;
+	}
+	// Print syntax hints.
+	if ('\0' != pCompletions->hints[0]) {
+		printf ("Please input: "); 
+		crossline_color_set (pCompletions->color_hints);
+		printf ("%s", pCompletions->hints); 
+		crossline_color_set (CROSSLINE_COLOR_DEFAULT);
+		printf ("\n");
+	}
+	if (0 == pCompletions->num)	{ return ret; }
+	if (NULL == (width = (int*)malloc (pCompletions->num * sizeof(int))))	{ return ret; }
+	for (i = 0; i < pCompletions->num; ++i) {
+		width[i] = crossline_str_width (pCompletions->items[i].word);
+		if (width[i] > word_len)	{ word_len = width[i]; }
+		if ('\0' != pCompletions->items[i].help[0])	{ with_help = 1; }
+	}
+	list.pCompletions	= pCompletions;
+	list.width			= width;
+	list.word_len		= word_len;
+	list.with_help		= with_help;
+	if (with_help) {
+		list.col_num = 1;
+		list.row_num = pCompletions->num;
+		if (crossline_pager_run ("Completions", pCompletions->num, crossline_completion_line, &list)) {
+			free (width);
+			return ret;
+		}
+		// Print words with help format.
+		for (i = 0; i < pCompletions->num; ++i) {
+			crossline_color_set (pCompletions->items[i].color_word);
+			printf ("%s", pCompletions->items[i].word);
+			printf ("%*s", 4 + word_len - width[i], "");
+			crossline_color_set (pCompletions->items[i].color_help);
+			printf ("%s", pCompletions->items[i].help);
+			crossline_color_set (CROSSLINE_COLOR_DEFAULT);
+			printf ("\n");
+			if (crossline_paging_check(crossline_str_width(pCompletions->items[i].help)+4+word_len+1))
+				{ break; }
+		}
+		free (width);
+		return ret;
+	}
+
+	/* Print words list in multiple columns like ls: words are ordered by column, each column is as
+	 * wide as its widest word, find the most columns which fit screen.
+	 */
+	crossline_screen_get (&rows, &cols);
+	col_num = (cols / 3 < pCompletions->num) ? cols / 3 : pCompletions->num;
+	if ((col_num < 1) || (NULL == (col_width = (int*)malloc (col_num * sizeof(int)))))	{ col_num = 1; col_width = &word_len; }
+	for (; col_num > 1; --col_num) {
+		row_num = (pCompletions->num + col_num - 1) / col_num;
+		memset (col_width, 0, col_num * sizeof(int));
+		for (i = 0; i < pCompletions->num; ++i) {
+			if (width[i] > col_width[i / row_num])	{ col_width[i / row_num] = width[i]; }
+		}
+		for (total = col_width[0], j = 1; (j < col_num) && (col_width[j] > 0); ++j)	{ total += 2 + col_width[j]; }
+		if (total < cols)	{ break; }
+	}
+	if (1 == col_num)	{ col_width[0] = word_len; }
+	row_num = (pCompletions->num + col_num - 1) / col_num;
+	list.col_width	= col_width;
+	list.col_num	= col_num;
+	list.row_num	= row_num;
+	if (crossline_pager_run ("Completions", row_num, crossline_completion_line, &list))
+		{ row_num = 0; } // shown in pager
+
+	for (i = 0; i < row_num; ++i) {
+		for (len = 0, j = 0; (j < col_num) && (i + j * row_num < pCompletions->num); ++j) {
+			item = &pCompletions->items[i + j * row_num];
+			if (j > 0) {
+				if (CROSSLINE_COLOR_DEFAULT != color) {
+					crossline_out_flush (out, &out_len);
+					crossline_color_set (color = CROSSLINE_COLOR_DEFAULT);
+				}
+				crossline_out_add (out, &out_len, sizeof(out), NULL, col_width[j-1] - width[i + (j-1) * row_num] + 2);
+				len += 2;
+			}
+			if (item->color_word != color) {
+				crossline_out_flush (out, &out_len);
+				crossline_color_set (color = item->color_word);
+			}
+			crossline_out_add (out, &out_len, sizeof(out), item->word, (int)strlen (item->word));
+			len += col_width[j];
+		}
+		if (CROSSLINE_COLOR_DEFAULT != color) {
+			crossline_out_flush (out, &out_len);
+			crossline_color_set (color = CROSSLINE_COLOR_DEFAULT);
+		}
+		crossline_out_add (out, &out_len, sizeof(out), "\n", 1);
+		if (crossline_paging_full (len))	{ crossline_out_flush (out, &out_len); }
+		if (crossline_paging_check (len))	{ break; }
+	}
+	crossline_out_flush (out, &out_len);
+	if (col_width != &word_len)	{ free (col_width); }
+	free (width);
+	return ret;
+}
+
+/*****************************************************************************/
+
+/* Incremental highlighting: spans cached per token tile the input. After edit, dirty range is found by
+ * comparing with last highlighted text, tokenizer restarts from the token before the change with its
+ * saved lexer state, and stops when a token after the change starts where an old one did with same
+ * state, then old spans are shifted. So callback work is proportional to the edit, not the line.
+ */
+typedef struct crossline_hl_span_t {
+	int		pos, len, state;	// state is lexer state at token start
+	crossline_color_e	color;
+} crossline_hl_span_t;
+
+static struct {
+	crossline_highlight_callback	func;
+	void		*arg;
+	int			on;		// Enabled for current edit (not history search)
+	crossline_hl_span_t	*spans, *work;
+	uint32_t	num, max, work_max;
+	char		*text;	// Last highlighted text
+	uint32_t	text_num, text_max;
+} s_hl;
+
+void crossline_highlight_register (crossline_highlight_callback pCbFunc, void *arg)
+{
+	s_hl.func = pCbFunc;
+	s_hl.arg = arg;
+	s_hl.num = s_hl.text_num = 0;
+}
+
+// Find index of span which contains pos.
+static uint32_t crossline_hl_find (int pos)
+{
+	uint32_t lo = 0, hi = s_hl.num, mid;
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (s_hl.spans[mid].pos <= pos) { lo = mid; } else { hi = mid; }
+	}
+	return lo;
+}
+
+/* Update spans for new buf, return first byte whose color may be changed on screen, num if nothing changed.
+ * Return 0 if spans can't be kept (no memory), then whole line is redrawn with default color.
+ */
+static int crossline_hl_update (const char *buf, int num)
+{
+	int prefix = 0, suffix = 0, old_num = (int)s_hl.text_num, delta = num - old_num, pos, state, len, diff, new_end, old_end;
+	uint32_t idx = 0, k, work_num = 0, i, j;
+	crossline_hl_span_t *span;
+
+	for (; (prefix < num) && (prefix < old_num) && (buf[prefix] == s_hl.text[prefix]); ++prefix)	;
+	if ((prefix == num) && (num == old_num))	{ return num; }
+	for (; (suffix < num - prefix) && (suffix < old_num - prefix) && (buf[num-1-suffix] == s_hl.text[old_num-1-suffix]); ++suffix)	;
+
+	pos = state = 0;
+	if (s_hl.num > 0) { // restart from token before change, appending may extend it
+		idx = crossline_hl_find (prefix > 0 ? prefix - 1 : 0);
+		pos = s_hl.spans[idx].pos;
+		state = s_hl.spans[idx].state;
+	}
+	for (k = idx; pos < num; pos += len) {
+		if (pos >= num - suffix) { // check resync with old token after change
+			for (; (k < s_hl.num) && (s_hl.spans[k].pos + delta < pos); ++k)	;
+			if ((k < s_hl.num) && (s_hl.spans[k].pos + delta == pos) && (s_hl.spans[k].pos >= old_num - suffix) && 
+				(s_hl.spans[k].state == state))	{ break; }
+		}
+		if (crossline_array_grow ((void**)&s_hl.work, &s_hl.work_max, work_num + 1, sizeof(crossline_hl_span_t)) < 0)
+			{ s_hl.num = s_hl.text_num = 0; return 0; }
+		span = &s_hl.work[work_num++];
+		span->pos = pos;
+		span->state = state;
+		span->color = CROSSLINE_COLOR_DEFAULT;
+		len = s_hl.func (buf, pos, num, &state, &span->color, s_hl.arg);
+		if (len <= 0)	{ len = 1; }
+		if (len > num - pos)	{ len = num - pos; }
+		span->len = len;
+	}
+	if (pos >= num)	{ k = s_hl.num; }
+
+	// first color change before edit, ex. keyword is completed, walk old and new spans by common segments
+	for (diff = (work_num > 0) ? s_hl.work[0].pos : prefix, i = 0, j = idx; diff < prefix; ) {
+		if ((i >= work_num) || (j >= s_hl.num) || (s_hl.work[i].color != s_hl.spans[j].color))	{ break; }
+		new_end = s_hl.work[i].pos + s_hl.work[i].len;
+		old_end = s_hl.spans[j].pos + s_hl.spans[j].len;
+		diff = (new_end < old_end) ? new_end : old_end;
+		if (new_end == diff)	{ i++; }
+		if (old_end == diff)	{ j++; }
+	}
+	if (diff > prefix)	{ diff = prefix; }
+
+	if ((crossline_array_grow ((void**)&s_hl.spans, &s_hl.max, idx + work_num + (s_hl.num - k), sizeof(crossline_hl_span_t)) < 0) || 
+		(crossline_array_grow ((void**)&s_hl.text, &s_hl.text_max, num + 1, 1) < 0))
+		{ s_hl.num = s_hl.text_num = 0; return 0; }
+	memmove (&s_hl.spans[idx + work_num], &s_hl.spans[k], (s_hl.num - k) * sizeof(crossline_hl_span_t));
+	memcpy (&s_hl.spans[idx], s_hl.work, work_num * sizeof(crossline_hl_span_t));
+	s_hl.num = idx + work_num + (s_hl.num - k);
+	for (i = idx + work_num; i < s_hl.num; ++i)	{ s_hl.spans[i].pos += delta; }
+	memmove (&s_hl.text[num - suffix], &s_hl.text[old_num - suffix], suffix);
+	memcpy (&s_hl.text[prefix], &buf[prefix], num - suffix - prefix);
+	s_hl.text_num = num;
+	return diff;
+}
+
+// Print buf[pos,stop) of num bytes input with span colors, color is only changed at span with different color.
+static void crossline_hl_print (const char *buf, int pos, int stop, int num)
+{
+	uint32_t i;
+	int end;
+	crossline_color_e color = CROSSLINE_COLOR_DEFAULT;
+
+	if (!s_hl.on || (s_hl.num == 0) || (s_hl.text_num != (uint32_t)num)) {
+		printf ("%.*s", stop - pos, &buf[pos]);
+		return;
+	}
+	for (i = crossline_hl_find (pos); (i < s_hl.num) && (pos < stop); ++i, pos = end) {
+		end = s_hl.spans[i].pos + s_hl.spans[i].len;
+		end = (end < stop) ? end : stop;
+		if (s_hl.spans[i].color != color)	{ crossline_color_set (color = s_hl.spans[i].color); }
+		printf ("%.*s", end - pos, &buf[pos]);
+	}
+	if (CROSSLINE_COLOR_DEFAULT != color)	{ crossline_color_set (CROSSLINE_COLOR_DEFAULT); }
+}
+
+/*****************************************************************************/
+
+/* Viewport for input taller than screen. Row starts of input are cached and only rows from the first changed
+ * byte are laid out again when they're needed, and only rows in viewport are printed, so edit and refreash
+ * cost is bounded by screen size instead of input length. Rows are laid out one column narrower than screen
+ * to avoid terminal auto wrap, and prompt must be narrower than screen.
+ */
+static struct {
+	int			*rows;		// Byte offset of each row start, row 0 starts after prompt
+	uint32_t	num, max;	// Laid out rows
+	int			cols, plen;	// Layout width and prompt cells
+	int			done;		// Laid out to input end
+	int			top;		// First row in viewport
+	int			on;			// Input is shown in viewport
+} s_view;
+
+// Drop rows from byte pos which is changed, pos 0 drops all, pos < 0 keeps layout if width and prompt are same.
+static int crossline_view_change (int cols, int plen, int pos)
+{
+	if ((s_view.cols != cols) || (s_view.plen != plen) || (0 == pos)) {
+		if (crossline_array_grow ((void**)&s_view.rows, &s_view.max, 1, sizeof(int)) < 0)	{ return -1; }
+		s_view.cols		= cols;
+		s_view.plen		= plen;
+		s_view.rows[0]	= 0;
+		s_view.num		= 1;
+		s_view.done		= 0;
+	} else if (pos > 0) {
+		while ((s_view.num > 1) && (s_view.rows[s_view.num - 1] >= pos))	{ s_view.num--; }
+		s_view.done = 0;
+	}
+	return 0;
+}
+
+// Lay out rows until row stop exists and a row starts after byte pos, or to input end.
+static int crossline_view_layout (const char *buf, int num, int stop, int pos)
+{
+	int cols = s_view.cols, row = (int)s_view.num - 1, cur = s_view.rows[row], next, end;
+	int cell = row ? row * cols : s_view.plen;
+
+	while (!s_view.done && (((int)s_view.num <= stop) || (s_view.rows[s_view.num - 1] <= pos))) {
+		if (cur >= num) { // cursor at end takes a new row if last row is full
+			s_view.done = 1;
+			if (cell / cols < (int)s_view.num)	{ break; }
+		} else {
+			next = crossline_char_next (buf, cur, num);
+			end = crossline_cell_add (cell, &buf[cur], next - cur, cols);
+			row = (end > cell) ? (end - 1) / cols : 0; // row of char start, wide char may be wrapped
+			cell = end;
+			if (row < (int)s_view.num)	{ cur = next; continue; }
+		}
+		if (crossline_array_grow ((void**)&s_view.rows, &s_view.max, s_view.num + 1, sizeof(int)) < 0)	{ return -1; }
+		s_view.rows[s_view.num++] = cur;
+		cur = (cur >= num) ? cur : next;
+	}
+	return 0;
+}
+
+// Cell of byte pos from prompt start, rows must be laid out after pos.
+static int crossline_view_cell (const char *buf, int pos)
+{
+	int lo = 0, hi = (int)s_view.num - 1, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (s_view.rows[mid] <= pos)	{ lo = mid; } else { hi = mid - 1; }
 	}
-	return crossline_history_dump (stdout, 1, pattern, his_id, 0);
+	return crossline_cell_add (lo ? lo * s_view.cols : s_view.plen, &buf[s_view.rows[lo]], pos - s_view.rows[lo], s_view.cols);
 }
 
-// Show completions returned by callback.
-static int crossline_show_completions (crossline_completions_t *pCompletions)
+/* Refreash input in viewport if it's taller than screen, return 0 if it fits screen, return 2 if viewport is
+ * cleared and input should be printed again from prompt, return 1 if refreashed. Viewport is scrolled to keep
+ * cursor in it, and only rows from the first changed row are printed.
+ */
+static int crossline_view_refreash (crossline_prompt_t *prompt, char *buf, int new_pos, int new_num, int bChg, int rows, int cols)
 {
-	int i, j, ret = 0, word_len = 0, with_help = 0, rows, cols, word_num;
-
-	if (('\0' != pCompletions->hints[0]) || (pCompletions->num > 0)) {
-		printf (" \b\n");
-		ret = 1;
+	int width = cols - 1, plen = crossline_prompt_cells (prompt, cols), top = s_view.top, bottom, cell, row, first, r, beg, end;
+	int old_row = s_view.on ? s_cur_cell / s_view.cols - s_view.top : s_cur_cell / cols, old_col = s_view.on ? s_cur_cell % s_view.cols : 0;
+
+	if ((plen >= width - 1) || (rows < 2) || (crossline_view_change (width, plen, bChg ? ((bChg > 1) ? bChg - 2 : 0) : -1) < 0) ||
+		(crossline_view_layout (buf, new_num, rows, -1) < 0))
+		{ s_view.on = 0; return 0; }
+	if ((int)s_view.num <= rows) { // fits screen now
+		if (!s_view.on)	{ return 0; }
+		crossline_cursor_move (-old_row, 0);
+		printf ("\r");
+		if (!s_crossline_win) {
+			printf ("\x1b[J");
+		} else {
+			for (r = 0; r < rows; ++r) {
+				for (end = 0; end < width; ++end)	{ printf (" "); }
+				if (r < rows - 1)	{ printf ("\n"); }
+			}
+			crossline_cursor_move (-(rows - 1), 0);
+			printf ("\r");
+		}
+		s_view.on	= 0;
+		s_cur_cell	= 0;
+		s_end_cell	= plen;
+		return 2;
 	}
-	// Print syntax hints.
-	if ('\0' != pCompletions->hints[0]) {
-		printf ("Please input: "); 
-		crossline_color_set (pCompletions->color_hints);
-		printf ("%s", pCompletions->hints); 
-		crossline_color_set (CROSSLINE_COLOR_DEFAULT);
-		printf ("\n");
+	first = bChg ? ((bChg > 1) ? bChg - 1 : 0) : new_num;
+	if (bChg && s_hl.on) { // edit may change color of tokens before change
+		r = crossline_hl_update (buf, new_num);
+		first = (r < first) ? r : first;
 	}
-	if (0 == pCompletions->num)	{ return ret; }
-	for (i = 0; i < pCompletions->num; ++i) {
-		if ((int)strlen(pCompletions->word[i]) > word_len)
-			{ word_len = (int)strlen(pCompletions->word[i]); }
-		if ('\0' != pCompletions->help[i][0])	{ with_help = 1; }
+	if (crossline_view_layout (buf, new_num, 0, new_pos) < 0)	{ s_view.on = 0; return 0; }
+	cell = crossline_view_cell (buf, new_pos);
+	row = cell / width;
+	if (!s_view.on || (row < top))	{ top = row; }
+	if (row >= top + rows)	{ top = row - rows + 1; }
+	crossline_view_layout (buf, new_num, top + rows, -1);
+	if (s_view.done && ((int)s_view.num < top + rows))	{ top = (int)s_view.num - rows; }
+	bottom = top + rows - 1;
+	if (!s_view.on) {
+		first = top;
+		crossline_cursor_move (-old_row, 0); // print viewport from prompt row
+		old_row = 0;
+	} else if (top != s_view.top) {
+		first = top;
+	} else {
+		first = bChg ? crossline_view_cell (buf, (first > 0) ? first - 1 : 0) / width : bottom + 1;
+		first = (first > top) ? first : top;
 	}
-	if (with_help) {
-		// Print words with help format.
-		for (i = 0; i < pCompletions->num; ++i) {
-			crossline_color_set (pCompletions->color_word[i]);
-			printf ("%s", pCompletions->word[i]);
-			for (j = 0; j < 4+word_len-(int)strlen(pCompletions->word[i]); ++j)
-				{ printf (" "); }
-			crossline_color_set (pCompletions->color_help[i]);
-			printf ("%s", pCompletions->help[i]);
-			crossline_color_set (CROSSLINE_COLOR_DEFAULT);
-			printf ("\n");
-			if (crossline_paging_check((int)strlen(pCompletions->help[i])+4+word_len+1))
-				{ break; }
+	s_ghost_len		= 0; // no ghost text and autosuggestion in viewport
+	s_suggest_id	= 0;
+	s_suggest_len	= -1;
+	if (first <= bottom) {
+		crossline_cursor_move (first - top - old_row, 0);
+		printf ("\r");
+		for (r = first; r <= bottom; ++r) {
+			end = 0;
+			if (0 == r) {
+				crossline_color_set (s_prompt_color);
+				printf ("%s", &prompt->text[prompt->last]);
+				crossline_color_set (CROSSLINE_COLOR_DEFAULT);
+				end = plen;
+			}
+			if (r < (int)s_view.num) {
+				beg = s_view.rows[r];
+				end = crossline_cell_add (end, &buf[beg], ((r + 1 < (int)s_view.num) ? s_view.rows[r+1] : new_num) - beg, 0);
+				crossline_hl_print (buf, beg, (r + 1 < (int)s_view.num) ? s_view.rows[r+1] : new_num, new_num);
+			}
+			if (!s_crossline_win) {
+				printf ("\x1b[K");
+			} else {
+				for (; end < width; ++end)	{ printf (" "); }
+			}
+			if (r < bottom)	{ printf ("\n"); }
 		}
-		return ret;
+		printf ("\r");
+		crossline_cursor_move (row - bottom, cell % width);
+	} else {
+		crossline_cursor_move (row - top - old_row, cell % width - old_col);
 	}
+	s_view.top	= top;
+	s_view.on	= 1;
+	s_cur_cell	= cell;
+	return 1;
+}
 
-	// Print words list in multiple columns.
+// Move cursor to char in previous or next screen row which is closest to current column.
+static int crossline_updown_move (crossline_prompt_t *prompt, char *buf, int *pCurPos, int *pCurNum, int off, int bForce)
+{
+	int rows, cols, cell, next, len, pos = 0, target, row;
 	crossline_screen_get (&rows, &cols);
-	word_num = (cols - 1 - word_len) / (word_len + 4) + 1;
-	for (i = 1; i <= pCompletions->num; ++i) {
-		crossline_color_set (pCompletions->color_word[i-1]);
-		printf ("%s", pCompletions->word[i-1]);
-		crossline_color_set (CROSSLINE_COLOR_DEFAULT);
-		for (j = 0; j < ((i%word_num)?4:0)+word_len-(int)strlen(pCompletions->word[i-1]); ++j)
-			{ printf (" "); }
-		if (0 == (i % word_num)) {
-			printf ("\n");
-			if (crossline_paging_check (word_len))
-				{ return ret; }
+	if (s_single_row)	{ return 0; } // only one row
+	if (!bForce && (*pCurPos == *pCurNum))	{ return 0; } // at end of last line
+	cell = crossline_prompt_cells (prompt, cols);
+	if (s_view.on) { // only rows near cursor are laid out, and viewport is scrolled by refreash
+		cols = s_view.cols;
+		row = s_cur_cell / cols + ((off < 0) ? -1 : 1);
+		if ((row < 0) || (crossline_view_layout (buf, *pCurNum, row + 1, -1) < 0) || (row >= (int)s_view.num))	{ return 0; }
+		pos = s_view.rows[row];
+		cell = row ? row * cols : cell;
+		target = row * cols + s_cur_cell % cols;
+	} else if (off < 0) {
+		if (s_cur_cell/cols == 0) { return 0; } // at first line
+		target = s_cur_cell - cols;
+	} else {
+		if (s_cur_cell/cols == crossline_cell_add (cell, buf, *pCurNum, cols)/cols) { return 0; } // at last line
+		target = s_cur_cell + cols;
+	}
+	for (; pos < *pCurNum; pos = next) {
+		next = crossline_char_next (buf, pos, *pCurNum);
+		len = crossline_cell_add (cell, &buf[pos], next - pos, cols);
+		if (len > target)	{ break; }
+		cell = len;
+	}
+	if ((off > 0) && (pos >= *pCurNum)) { pos = crossline_char_prev (buf, *pCurNum); } // one char left to avoid history shortcut
+	crossline_refreash (prompt, buf, pCurPos, pCurNum, pos, *pCurNum, 0);
+	return 1;
+}
+
+/* Find most recent history which starts with buf and is longer than it, return ghost text or NULL.
+ * If input only grows at end of last matched prefix, narrow from last suggestion instead of rescanning,
+ * as newer history didn't match shorter prefix, they can't match longer one either.
+ */
+static const char* crossline_suggest_update (const char *buf, int num, int chg_pos)
+{
+	uint32_t id = s_history_id;
+	const char *history;
+
+	if (s_suggest_hide) { return NULL; }
+	if (!s_suggest_on || (0 == num)) {
+		s_suggest_id = 0;
+		s_suggest_len = -1;
+		return NULL;
+	}
+	if ((s_suggest_len > 0) && (chg_pos-1 == s_suggest_len) && (num > s_suggest_len)) {
+		if (0 == s_suggest_id) { // no history matched shorter prefix
+			s_suggest_len = num;
+			return NULL;
 		}
+		history = s_history_buf[(s_suggest_id-1) % CROSS_HISTORY_MAX_LINE];
+		if (!strncmp (&history[s_suggest_len], &buf[s_suggest_len], num - s_suggest_len) && ('\0' != history[num])) {
+			s_suggest_len = num;
+			return &history[num];
+		}
+		id = s_suggest_id - 1;
+	}
+	for (; (id > 0) && (id + CROSS_HISTORY_MAX_LINE > s_history_id); --id) {
+		history = s_history_buf[(id-1) % CROSS_HISTORY_MAX_LINE];
+		if (!strncmp (history, buf, num) && ('\0' != history[num]))
+			{ break; }
 	}
+	s_suggest_id = ((id > 0) && (id + CROSS_HISTORY_MAX_LINE > s_history_id)) ? id : 0;
+	s_suggest_len = num;
+	return s_suggest_id ? &s_history_buf[(s_suggest_id-1) % CROSS_HISTORY_MAX_LINE][num] : NULL;
+}
 
-	if (pCompletions->num % word_num) { printf ("\n"); }
-	return ret;
+// Get ghost text shown after input: async spinner, history suggestion or live hint.
+static const char* crossline_ghost_get (char *buf, int new_pos, int new_num, int bChg)
+{
+	const char *ghost;
+
+	buf[new_num] = '\0';
+	ghost = crossline_suggest_update (buf, new_num, bChg);
+	ghost = ((NULL != s_ghost_hint) && !s_suggest_hide) ? s_ghost_hint : ghost;
+	if ((NULL == ghost) && !s_suggest_hide && s_live_hint.on && ('\0' != s_live_hint.text[0]) && (new_pos == new_num) && 
+		(s_live_hint.len == new_num) && (s_live_hint.hash == crossline_hash (buf)))
+		{ ghost = s_live_hint.text; } // only for line version they're computed for
+	return ghost;
 }
 
-static int crossline_updown_move (const char *prompt, int *pCurPos, int *pCurNum, int off, int bForce)
+int crossline_single_row_set (int enable)
 {
-	int rows, cols, len = (int)strlen(prompt), cur_pos=*pCurPos;
-	crossline_screen_get (&rows, &cols);
-	if (!bForce && (*pCurPos == *pCurNum))	{ return 0; } // at end of last line
-	if (off < 0) {
-		if ((*pCurPos+len)/cols == 0) { return 0; } // at first line
-		*pCurPos -= cols;
-		if (*pCurPos < 0) { *pCurPos = 0; }
-		crossline_cursor_move (-1, (*pCurPos+len)%cols-(cur_pos+len)%cols);
+	int prev = s_single_row;
+	s_single_row = enable;
+	return prev;
+}
+
+// Earliest char start from which text to pos takes no more than max cells.
+static int crossline_row_start (const char *buf, int pos, int max)
+{
+	int prev, cell = 0;
+
+	for (; pos > 0; pos = prev) {
+		prev = crossline_char_prev (buf, pos);
+		if ((cell = crossline_cell_add (cell, &buf[prev], pos - prev, 0)) > max)	{ break; }
+	}
+	return pos;
+}
+
+/* Single row mode: show window of input around cursor after prompt with '<' '>' marks for hidden text.
+ * Window only slides when cursor goes out of it, and only window width chars are printed for each refreash,
+ * so output is bounded by screen width for any input length. Last column is kept empty to avoid wrap.
+ */
+static void crossline_row_refreash (crossline_prompt_t *prompt, char *buf, int new_pos, int new_num, int bChg, const char *ghost, int cols)
+{
+	int plen = crossline_prompt_cells (prompt, cols), width = cols - 1 - plen, off = s_row_off, end, prev, cell, left, i;
+
+	if (width < 4)	{ width = 4; }
+	if (!bChg && (new_pos >= off) && ((new_pos < s_row_end) || (new_pos == new_num && s_row_end == new_num))) { // in window, just move cursor
+		cell = crossline_cell_add (plen + ((off > 0) ? 1 : 0), &buf[off], new_pos - off, 0);
+		crossline_cursor_move (0, cell - s_cur_cell);
+		s_cur_cell = cell;
+		return;
+	}
+	s_ghost_len = (NULL != ghost) ? (int)strlen (ghost) : 0;
+	// keep window start at char boundary, slide it to put cursor in middle if cursor is out of window
+	for (off = (off < new_num) ? off : new_num; (off > 0) && ((buf[off] & 0xC0) == 0x80); --off)
+		;
+	if ((new_pos < off) || (crossline_row_start (buf, new_pos, width - 4) > off))
+		{ off = crossline_row_start (buf, new_pos, width / 2); }
+	// fill window if tail is short
+	if (0 == crossline_row_start (buf, new_num, width - 1)) {
+		off = 0;
+	} else if ((prev = crossline_row_start (buf, new_num, width - 2)) < off)
+		{ off = prev; }
+	left = (off > 0) ? 1 : 0;
+	// window end, one cell is left for '>' if text is hidden
+	for (end = off, cell = 0; end < new_num; end = i) {
+		i = crossline_char_next (buf, end, new_num);
+		if (crossline_cell_add (cell, &buf[end], i - end, 0) > width - left)	{ break; }
+		cell = crossline_cell_add (cell, &buf[end], i - end, 0);
+	}
+	while ((end < new_num) && (cell > width - left - 1)) {
+		prev = crossline_char_prev (buf, end);
+		cell -= crossline_cell_add (0, &buf[prev], end - prev, 0);
+		end = prev;
+	}
+	printf ("\r");
+	crossline_color_set (s_prompt_color);
+	printf ("%s", &prompt->text[prompt->last]);
+	crossline_color_set (CROSSLINE_COLOR_DEFAULT);
+	if (left)	{ printf ("<"); }
+	crossline_hl_print (buf, off, end, new_num);
+	cell += plen + left;
+	if (end < new_num) {
+		printf (">");
+		cell++;
+	} else if (s_ghost_len > 0) {
+		crossline_color_set (s_suggest_color);
+		cell += crossline_cells_print (ghost, plen + width - cell);
+		crossline_color_set (CROSSLINE_COLOR_DEFAULT);
+	}
+	if (!s_crossline_win) {
+		printf ("\x1b[K");
 	} else {
-		if ((*pCurPos+len)/cols == (*pCurNum+len)/cols) { return 0; } // at last line
-		*pCurPos += cols;
-		if (*pCurPos > *pCurNum) { *pCurPos = *pCurNum - 1; } // one char left to avoid history shortcut
-		crossline_cursor_move (1, (*pCurPos+len)%cols-(cur_pos+len)%cols);
+		for (i = s_end_cell - cell; i > 0; --i)	{ printf (" "); }
 	}
-	return 1;
+	s_row_off	= off;
+	s_row_end	= end;
+	s_end_cell	= cell;
+	s_cur_cell	= crossline_cell_add (plen + left, &buf[off], new_pos - off, 0);
+	printf ("\r");
+	crossline_cursor_move (0, s_cur_cell);
 }
 
-// Refreash current print line and move cursor to new_pos.
-static void crossline_refreash (const char *prompt, char *buf, int *pCurPos, int *pCurNum, int new_pos, int new_num, int bChg)
+/* Refreash current print line and move cursor to new_pos.
+ * Positions are tracked as screen cells from prompt start, as UTF-8 chars may take 0-2 cells and buf 
+ * is already changed when called. bChg=0 just moves cursor, bChg=1 redraws whole line, otherwise print
+ * from buf[bChg-1] which must be at cursor.
+ */
+static void crossline_refreash (crossline_prompt_t *prompt, char *buf, int *pCurPos, int *pCurNum, int new_pos, int new_num, int bChg)
 {
-	int i, pos_row, pos_col, len = (int)strlen(prompt);
+	int i, pos_row, plen, new_cell, new_end, old_end;
 	static int rows = 0, cols = 0;
+	const char *ghost;
 
 	if (bChg || !rows || s_crossline_win) { crossline_screen_get (&rows, &cols); }
+	plen = crossline_prompt_cells (prompt, cols);
+	if (s_cur_cell < 0) { // fresh line
+		s_cur_cell = 0;
+		s_end_cell = plen;
+		s_row_off = s_row_end = 0;
+		s_view.on = 0;
+	}
+	if (new_pos > new_num) { new_pos = new_num; }
+	if (s_single_row) {
+		ghost = bChg ? crossline_ghost_get (buf, new_pos, new_num, bChg) : NULL;
+		if (bChg && s_hl.on)	{ crossline_hl_update (buf, new_num); }
+		crossline_row_refreash (prompt, buf, new_pos, new_num, bChg, ghost, cols);
+		*pCurPos = new_pos;
+		*pCurNum = new_num;
+		return;
+	}
+	if (bChg || s_view.on) {
+		i = crossline_view_refreash (prompt, buf, new_pos, new_num, bChg, rows, cols);
+		if (1 == i) {
+			*pCurPos = new_pos;
+			*pCurNum = new_num;
+			return;
+		}
+		bChg = (2 == i) ? 1 : bChg; // input is printed again from prompt after leaving viewport
+	}
+	new_cell = crossline_cell_add (plen, buf, new_pos, cols);
 	if (!bChg) { // just move cursor
-		pos_row = (new_pos+len)/cols - (*pCurPos+len)/cols;
-		pos_col = (new_pos+len)%cols - (*pCurPos+len)%cols;
-		crossline_cursor_move (pos_row, pos_col);
+		pos_row = new_cell/cols - s_cur_cell/cols;
+		crossline_cursor_move (pos_row, new_cell%cols - s_cur_cell%cols);
 	} else {
-		buf[new_num] = '\0';
+		ghost = crossline_ghost_get (buf, new_pos, new_num, bChg);
+		if (s_hl.on) { // edit may change color of tokens before bChg
+			i = crossline_hl_update (buf, new_num);
+			if ((bChg > 1) && (i < bChg-1)) {
+				pos_row = crossline_cell_add (plen, buf, i, cols);
+				crossline_cursor_move (pos_row/cols - s_cur_cell/cols, pos_row%cols - s_cur_cell%cols);
+				s_cur_cell = pos_row;
+				bChg = i + 1;
+			}
+		}
 		if (bChg > 1) { // refreash as less as possbile
-			printf ("%s", &buf[bChg-1]);
+			crossline_hl_print (buf, bChg-1, new_num, new_num);
 		} else {
-			pos_row = (*pCurPos + len) / cols;
-			crossline_cursor_move (-pos_row, 0);
+			crossline_cursor_move (-(s_cur_cell/cols), 0);
 			crossline_color_set (s_prompt_color);
-			printf ("\r%s", prompt);
+			printf ("\r%s", &prompt->text[prompt->last]);
+			crossline_color_set (CROSSLINE_COLOR_DEFAULT);
+			crossline_hl_print (buf, 0, new_num, new_num);
+		}
+		// ghost text is printed after input and erased like input
+		old_end = s_end_cell;
+		s_ghost_len = (NULL != ghost) ? (int)strlen(ghost) : 0;
+		new_end = crossline_cell_add (new_cell, &buf[new_pos], new_num - new_pos, cols);
+		if (s_ghost_len > 0) {
+			crossline_color_set (s_suggest_color);
+			printf ("%s", ghost);
 			crossline_color_set (CROSSLINE_COLOR_DEFAULT);
-			printf ("%s", buf);
+			new_end = crossline_cell_add (new_end, ghost, s_ghost_len, cols);
 		}
-		if (!s_crossline_win && new_num>0 && !((new_num+len)%cols)) { printf("\n"); }
-		for (i=*pCurNum-new_num; i > 0; --i) { printf (" "); }
-		if (!s_crossline_win && *pCurNum>new_num && !((*pCurNum+len)%cols)) { printf("\n"); }
-		pos_row = (new_num+len)/cols - (*pCurNum+len)/cols;
-		if (pos_row < 0) { crossline_cursor_move (pos_row, 0); } 
+		// cursor waits at row end after printing last column, move it to next row as cell math assumes
+		if (!s_crossline_win && !(new_end%cols) && ((1 == bChg) ? (new_end > 0) : ((new_num >= bChg) || (s_ghost_len > 0)))) { printf("\n"); }
+		for (i=old_end-new_end; i > 0; --i) { printf (" "); }
+		if (!s_crossline_win && old_end>new_end && !(old_end%cols)) { printf("\n"); }
+		pos_row = new_end/cols - old_end/cols;
+		if (pos_row < 0) { crossline_cursor_move (pos_row, 0); }
 		printf ("\r");
-		pos_row = (new_pos+len)/cols - (new_num+len)/cols;
-		crossline_cursor_move (pos_row, (new_pos+len)%cols);
+		pos_row = new_cell/cols - new_end/cols;
+		crossline_cursor_move (pos_row, new_cell%cols);
+		s_end_cell = new_end;
 	}
+	s_cur_cell = new_cell;
 	*pCurPos = new_pos;
 	*pCurNum = new_num;
 }
 
-static void crossline_print (const char *prompt, char *buf, int *pCurPos, int *pCurNum, int new_pos, int new_num)
+static void crossline_print (crossline_prompt_t *prompt, char *buf, int *pCurPos, int *pCurNum, int new_pos, int new_num)
 {
 	*pCurPos = *pCurNum = 0;
+	s_ghost_len = 0;
+	s_cur_cell = s_end_cell = -1;
+	if (prompt->last > 0) { // lines before last prompt line
+		crossline_color_set (s_prompt_color);
+		printf ("\r%.*s", prompt->last, prompt->text);
+		crossline_color_set (CROSSLINE_COLOR_DEFAULT);
+	}
 	crossline_refreash (prompt, buf, pCurPos, pCurNum, new_pos, new_num, 1);
 }
 
+// Erase ghost text after input before printing below input line.
+static void crossline_ghost_clear (crossline_prompt_t *prompt, char *buf, int *pCurPos, int *pCurNum)
+{
+	int pos = *pCurPos;
+	if (s_ghost_len > 0) {
+		crossline_refreash (prompt, buf, pCurPos, pCurNum, *pCurNum, *pCurNum, 0);
+		s_suggest_hide = 1;
+		crossline_refreash (prompt, buf, pCurPos, pCurNum, pos, *pCurNum, *pCurNum+1);
+		s_suggest_hide = 0;
+	}
+}
+
+/* Wait while async completion is running and show spinner after input, return key to apply results
+ * when they're ready or deadline passed, return 0 if user presses key. Request is cancelled if line is changed.
+ */
+static int crossline_async_wait (crossline_prompt_t *prompt, char *buf, int *pCurPos, int *pCurNum)
+{
+	static const char *spinner[] = {" |", " /", " -", " \\"};
+	crossline_async_job_t *job = s_async_job;
+	int i, key = 0;
+
+	if (NULL == job)	{ return 0; }
+	buf[*pCurNum] = '\0';
+	if ((*pCurPos != *pCurNum) || strcmp (job->line, buf)) {
+		crossline_async_cancel ();
+		return 0;
+	}
+	for (i = 0; ; ++i) {
+		if (crossline_async_ready (job))	{ key = job->key; break; }
+		s_ghost_hint = spinner[i % 4];
+		crossline_refreash (prompt, buf, pCurPos, pCurNum, *pCurNum, *pCurNum, *pCurNum+1);
+		if (crossline_input_wait (100))	{ break; }
+	}
+	if (NULL != s_ghost_hint) {
+		s_ghost_hint = NULL;
+		crossline_refreash (prompt, buf, pCurPos, pCurNum, *pCurNum, *pCurNum, *pCurNum+1);
+	}
+	return key;
+}
+
+/*****************************************************************************/
+
+/* Any thread can print output above prompt: messages are pushed to a lock-free stack, and editing thread is
+ * woken by a pipe (Windows console polls). Editing thread takes all messages at once, clears input rows, prints
+ * them in one write and redraws input once, and it prints at most once per CROSS_ABOVE_PRINT_MS, so a burst of
+ * messages costs one redraw.
+ */
+
+// Create wake pipe in editing thread before other threads print above prompt.
+static void crossline_above_init (void)
+{
+	if (s_above.on)	{ return; }
+#ifndef _WIN32
+	if (pipe (s_above.pipe) < 0)	{ return; }
+	fcntl (s_above.pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl (s_above.pipe[1], F_SETFL, O_NONBLOCK);
+	fcntl (s_above.pipe[0], F_SETFD, FD_CLOEXEC);
+	fcntl (s_above.pipe[1], F_SETFD, FD_CLOEXEC);
+#endif
+	s_above.on = 1;
+}
+
+// Write all queued messages in order with stdout locked, each message ends with newline.
+static void crossline_above_write (void)
+{
+	crossline_msg_t *msg = (crossline_msg_t*)crossline_atomic_xchg (&s_above.head, NULL), *list = NULL, *next;
+	char out[4096];
+	int len = 0;
+
+	if (NULL == msg)	{ return; }
+	for (; NULL != msg; msg = next) { // reverse to printing order
+		next = msg->next;
+		msg->next = list;
+		list = msg;
+	}
+	crossline_file_lock (stdout); // batch isn't interleaved with batch written by other thread
+	for (msg = list; NULL != msg; msg = next) {
+		crossline_out_add (out, &len, sizeof(out), msg->text, msg->len);
+		if ((0 == msg->len) || ('\n' != msg->text[msg->len-1]))	{ crossline_out_add (out, &len, sizeof(out), "\n", 1); }
+		next = msg->next;
+		free (msg);
+	}
+	crossline_out_flush (out, &len);
+	fflush (stdout);
+	crossline_file_unlock (stdout);
+}
+
+int crossline_print_above (const char *text)
+{
+	crossline_msg_t *msg, *head;
+	int len;
+
+	if (NULL == text)	{ return -1; }
+	len = (int)strlen (text);
+	if (NULL == (msg = (crossline_msg_t*)malloc (sizeof(crossline_msg_t) + len)))	{ return -1; }
+	memcpy (msg->text, text, len + 1);
+	msg->len = len;
+	do {
+		head = s_above.head;
+		msg->next = head;
+	} while (!crossline_atomic_cas (&s_above.head, head, msg));
+	/* Checked after push: editing thread and pager drain after editing or hold is decreased, so either they take
+	 * this message or it's seen here that no line is being edited and no pager is shown, then it's printed directly.
+	 */
+	if ((0 == s_above.editing) && (0 == s_above.hold)) {
+		crossline_above_write ();
+		return 0;
+	}
+#ifndef _WIN32
+	if ((NULL == head) && (s_above.pipe[1] >= 0)) { // editing thread takes all, so only first one wakes it
+		if (write (s_above.pipe[1], "", 1) < 0)	{ /* pipe is full, it's woken already */ }
+	}
+#endif
+	return 0;
+}
+
+int crossline_printf_above (const char *fmt, ...)
+{
+	char buf[1024], *text = buf;
+	int len, ret;
+	va_list ap;
+
+	va_start (ap, fmt);
+	len = vsnprintf (buf, sizeof(buf), fmt, ap);
+	va_end (ap);
+	if (len < 0)	{ return -1; }
+	if ((len >= (int)sizeof(buf)) && (NULL != (text = (char*)malloc (len + 1)))) {
+		va_start (ap, fmt);
+		vsnprintf (text, len + 1, fmt, ap);
+		va_end (ap);
+	}
+	if (NULL == text)	{ text = buf; }
+	ret = crossline_print_above (text);
+	if (text != buf)	{ free (text); }
+	return ret;
+}
+
+/* Wait key, meanwhile redraw dynamic prompt when it's marked dirty (checked every 100ms) and print output above
+ * prompt. Input rows are cleared from first prompt row, then output and prompt are printed and input is redrawn.
+ */
+static void crossline_prompt_wait (crossline_prompt_t *prompt, char *buf, int *pCurPos, int *pCurNum)
+{
+	int rows, cols, pos = *pCurPos, dirty, ready, timeout, n;
+	uint64_t now;
+
+	if ((NULL == prompt->func) && !s_above.on)	{ return; }
+	do {
+		now = crossline_time_ms ();
+		dirty = (NULL != prompt->func) && prompt->dirty;
+		ready = (NULL != s_above.head) && !s_above.hold && (now >= s_above.last + CROSS_ABOVE_PRINT_MS);
+		if (dirty || ready) {
+			crossline_screen_get (&rows, &cols);
+			n = crossline_prompt_rows (prompt, cols) + s_end_cell / cols + 1; // rows to clear for Windows
+			crossline_refreash (prompt, buf, pCurPos, pCurNum, 0, *pCurNum, 0);
+			crossline_cursor_move (s_view.on ? -(s_cur_cell / s_view.cols - s_view.top) : 
+									-(s_cur_cell / cols) - crossline_prompt_rows (prompt, cols), 0);
+			printf ("\r");
+			if (!s_crossline_win)	{ printf ("\x1b[J"); }
+			if (ready) {
+				if (s_crossline_win) {
+					n = (n < rows) ? n : rows;
+					printf ("%*s\r", n * cols - 1, "");
+					crossline_cursor_move (n - 1, 0);
+				}
+				crossline_above_write ();
+				s_above.last = now;
+			}
+			if (dirty)	{ crossline_prompt_render (prompt); }
+			crossline_print (prompt, buf, pCurPos, pCurNum, pos, *pCurNum);
+			fflush (stdout);
+		}
+		timeout = (NULL != prompt->func) ? 100 : -1;
+		if ((NULL != s_above.head) && !s_above.hold) { // wait rest of print interval
+			n = (int)(s_above.last + CROSS_ABOVE_PRINT_MS - crossline_time_ms ());
+			n = (n > 0) ? n : 0;
+			timeout = ((timeout < 0) || (n < timeout)) ? n : timeout;
+		}
+	} while (!crossline_input_wait (timeout));
+}
+
+int crossline_hints_live_set (int enable, int delay_ms)
+{
+	int prev = s_live_hint.on;
+	s_live_hint.on = enable;
+	s_live_hint.delay = (delay_ms > 0) ? delay_ms : CROSS_LIVE_HINT_DELAY;
+	s_live_hint.len = -1;
+	return prev;
+}
+
+/* Compute live hints when user stops typing for delay, keys typed within delay are coalesced and no callback
+ * is run for them. Hints are got from completion callback (skipped in async mode as it may be slow) and grammar,
+ * and are shown as ghost text after input, so only changed cells are redrawn.
+ */
+static void crossline_live_hint (crossline_prompt_t *prompt, char *buf, int *pCurPos, int *pCurNum)
+{
+	crossline_completions_t *pCompletions = &s_live_hint.completions;
+	uint32_t hash;
+
+	if (!s_live_hint.on || (0 == *pCurNum) || (*pCurPos != *pCurNum) || ((s_ghost_len > 0) && s_suggest_id) || 
+		((NULL == crossline_completion_source ()) && (NULL == s_completion_grammar)))
+		{ return; }
+	buf[*pCurNum] = '\0';
+	hash = crossline_hash (buf);
+	if ((s_live_hint.len == *pCurNum) && (s_live_hint.hash == hash))	{ return; } // already computed
+	if (crossline_input_wait (s_live_hint.delay))	{ return; } // debounce
+	crossline_completions_reset (pCompletions);
+	if ((NULL != crossline_completion_source ()) && !s_async_on)
+		{ crossline_completion_call (buf, pCompletions); }
+	if (NULL != s_completion_grammar)
+		{ crossline_grammar_complete (s_completion_grammar, buf, pCompletions); }
+	snprintf (s_live_hint.text, sizeof(s_live_hint.text), "%s%s", 
+		((*pCurNum > 0) && (' ' != buf[*pCurNum-1]) && ('\0' != pCompletions->hints[0])) ? " " : "", pCompletions->hints);
+	s_live_hint.len = *pCurNum;
+	s_live_hint.hash = hash;
+	crossline_refreash (prompt, buf, pCurPos, pCurNum, *pCurNum, *pCurNum, *pCurNum+1);
+}
+
+// Accept whole autosuggestion or one word of it, cursor must be at end of input.
+static int crossline_suggest_accept (crossline_prompt_t *prompt, char *buf, int size, int *pCurPos, int *pCurNum, int word)
+{
+	int len = 0, num = *pCurNum;
+	const char *ghost;
+
+	if ((*pCurPos != num) || (0 == s_ghost_len) || (0 == s_suggest_id) || (s_suggest_len != num) || (NULL != s_ghost_hint))
+		{ return 0; }
+	ghost = &s_history_buf[(s_suggest_id-1) % CROSS_HISTORY_MAX_LINE][num];
+	if (word) {
+		for (; ('\0' != ghost[len]) && isdelim(ghost[len]); ++len)	;
+		for (; ('\0' != ghost[len]) && !isdelim(ghost[len]); ++len)	;
+	} else
+		{ len = (int)strlen (ghost); }
+	if (len > size - 1 - num)	{ len = size - 1 - num; }
+	if (len <= 0)	{ return 0; }
+	memcpy (&buf[num], ghost, len);
+	crossline_refreash (prompt, buf, pCurPos, pCurNum, num+len, num+len, num+1);
+	return 1;
+}
+
 // Copy part text[cut_beg, cut_end] from src to dest
 static void crossline_text_copy (char *dest, const char *src, int cut_beg, int cut_end)
 {
@@ -919,7 +5205,7 @@ static void crossline_text_copy (char *dest, const char *src, int cut_beg, int c
 }
 
 // Copy from history buffer to dest
-static void crossline_history_copy (const char *prompt, char *buf, int size, int *pos, int *num, int history_id)
+static void crossline_history_copy (crossline_prompt_t *prompt, char *buf, int size, int *pos, int *num, int history_id)
 {
 	strncpy (buf, s_history_buf[history_id % CROSS_HISTORY_MAX_LINE], size - 1);
 	buf[size - 1] = '\0';
@@ -1047,30 +5333,438 @@ static void crossline_winchg_reg (void)
 
 /*****************************************************************************/
 
+/* Full-screen pager on alternate screen for output taller than screen. Lines are got from line callback
+ * only when they're shown, so nothing is printed eagerly and any number of lines is shown at once.
+ * Long lines are clipped and scrolled with Left/Right. Terminal only, Windows console uses one-way paging.
+ */
+typedef struct crossline_pager_t {
+	const char	*title;
+	crossline_pager_callback	func;
+	void		*arg;
+	int			num, top, col, match;
+	char		pattern[256];
+	const char	*msg;
+} crossline_pager_t;
+
+// Append line clipped to cells [skip, skip+width) to output, SGR sequences are kept, control chars are dropped.
+static void crossline_pager_clip (char *out, int *pLen, int size, const char *text, int skip, int width)
+{
+	int i, n, w, cell = 0;
+	uint32_t code;
+
+	for (i = 0; '\0' != text[i]; i += n) {
+		if (('\x1b' == text[i]) && ('[' == text[i+1])) {
+			for (n = 2; ('\0' != text[i+n]) && ((text[i+n] < 0x40) || (text[i+n] > 0x7E)); ++n)	;
+			n += ('\0' != text[i+n]) ? 1 : 0;
+			crossline_out_add (out, pLen, size, &text[i], n);
+			continue;
+		}
+		n = crossline_utf8_decode (&text[i], &code);
+		w = crossline_char_width (code);
+		if ((code < 0x20) || (code == 0x7F))	{ continue; }
+		if (cell < skip) {
+			cell += w;
+			if (cell > skip)	{ crossline_out_add (out, pLen, size, NULL, cell - skip); } // wide char is cut
+			continue;
+		}
+		if (cell + w > skip + width)	{ break; }
+		crossline_out_add (out, pLen, size, &text[i], n);
+		cell += w;
+	}
+}
+
+// Print visible page and status row with one buffered write.
+static void crossline_pager_draw (crossline_pager_t *pager, int rows, int cols)
+{
+	char out[4096], line[CROSS_PAGER_LINE_LEN];
+	const char *text;
+	int r, len = 0, idx;
+
+	crossline_out_add (out, &len, sizeof(out), "\x1b[H", 3);
+	for (r = 0; r < rows - 1; ++r) {
+		idx = pager->top + r;
+		if (idx < pager->num) {
+			if (idx == pager->match)	{ crossline_out_add (out, &len, sizeof(out), "\x1b[7m", 4); }
+			if (NULL != (text = pager->func (idx, line, sizeof(line), pager->arg)))
+				{ crossline_pager_clip (out, &len, sizeof(out), text, pager->col, cols - 1); }
+		} else
+			{ crossline_out_add (out, &len, sizeof(out), "~", 1); }
+		crossline_out_add (out, &len, sizeof(out), "\x1b[m\x1b[K\r\n", 8);
+	}
+	idx = pager->top + rows - 1;
+	snprintf (line, sizeof(line), " %s  %d-%d/%d  %s", pager->title, pager->num ? pager->top + 1 : 0, 
+				(idx < pager->num) ? idx : pager->num, pager->num, 
+				(NULL != pager->msg) ? pager->msg : "q:quit /:search n/N:next/prev Up/Down/PgUp/PgDn/Left/Right");
+	crossline_out_add (out, &len, sizeof(out), "\x1b[7m", 4);
+	crossline_pager_clip (out, &len, sizeof(out), line, 0, cols - 1);
+	crossline_out_add (out, &len, sizeof(out), "\x1b[m\x1b[K", 6);
+	crossline_out_flush (out, &len);
+	fflush (stdout);
+}
+
+// Find line with pattern (case insensitive) from match in direction dir, wrap at end.
+static void crossline_pager_search (crossline_pager_t *pager, int dir, int rows)
+{
+	char line[CROSS_PAGER_LINE_LEN];
+	const char *text;
+	int i, idx = (pager->match >= 0) ? pager->match : pager->top - dir;
+
+	pager->msg = "Pattern not found";
+	if ('\0' == pager->pattern[0])	{ return; }
+	for (i = 0; i < pager->num; ++i) {
+		idx = (idx + dir + pager->num) % pager->num;
+		if (NULL == (text = pager->func (idx, line, sizeof(line), pager->arg)))	{ continue; }
+		if (text != line) {
+			strncpy (line, text, sizeof(line) - 1);
+			line[sizeof(line) - 1] = '\0';
+		}
+		crossline_str_fold (line, line);
+		if (NULL != strstr (line, pager->pattern)) {
+			pager->match = idx;
+			pager->msg = NULL;
+			if ((idx < pager->top) || (idx >= pager->top + rows - 1))	{ pager->top = idx; }
+			return;
+		}
+	}
+}
+
+// Show lines in pager if they don't fit screen, return 0 if not shown so caller prints them.
+static int crossline_pager_run (const char *title, int num, crossline_pager_callback pCbFunc, void *arg)
+{
+	crossline_pager_t pager;
+	char line[CROSS_PAGER_LINE_LEN];
+	const char *text;
+	int rows, cols, i, len, ch, is_esc, page;
+
+	if (s_crossline_win || (s_paging_print_line < 0) || !isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))	{ return 0; }
+	crossline_screen_get (&rows, &cols);
+	if (num < rows) { // only check whether short output fits screen
+		for (i = len = 0; (i < num) && (len < rows - 1); ++i) {
+			text = pCbFunc (i, line, sizeof(line), arg);
+			len += ((NULL != text) && (('\0' != text[0]))) ? (crossline_ansi_cells (text, (int)strlen (text), 0) + cols - 1) / cols : 1;
+		}
+		if (len < rows - 1)	{ return 0; }
+	}
+	memset (&pager, 0, sizeof(pager));
+	pager.title	= (NULL != title) ? title : "";
+	pager.func	= pCbFunc;
+	pager.arg	= arg;
+	pager.num	= num;
+	pager.match	= -1;
+	printf ("\x1b[?1049h"); // alternate screen
+	crossline_cursor_hide (1);
+	crossline_atomic_add (&s_above.hold, 1);
+	for (;;) {
+		crossline_screen_get (&rows, &cols);
+		page = (rows > 2) ? rows - 1 : 1;
+		if (pager.top > num - page)	{ pager.top = num - page; }
+		if (pager.top < 0)	{ pager.top = 0; }
+		crossline_pager_draw (&pager, rows, cols);
+		pager.msg = NULL;
+		is_esc = 0;
+		ch = crossline_key_mapping (crossline_getkey (&is_esc));
+		switch (ch) {
+		case KEY_UP: case 'k': case 'y': case CTRL_KEY('P'):
+			pager.top--;	break;
+		case KEY_DOWN: case 'j': case 'e': case KEY_ENTER: case KEY_ENTER2: case CTRL_KEY('N'):
+			pager.top++;	break;
+		case KEY_PGUP: case 'b': case CTRL_KEY('B'):
+			pager.top -= page;	break;
+		case KEY_PGDN: case ' ': case 'f': case CTRL_KEY('F'):
+			pager.top += page;	break;
+		case KEY_HOME: case 'g': case '<':
+			pager.top = 0;	break;
+		case KEY_END: case 'G': case '>':
+			pager.top = num;	break;
+		case KEY_LEFT:
+			pager.col = (pager.col > cols / 2) ? pager.col - cols / 2 : 0;	break;
+		case KEY_RIGHT:
+			pager.col += cols / 2;	break;
+		case '/':
+			crossline_cursor_set (rows - 1, 0);
+			printf ("\x1b[K");
+			crossline_cursor_hide (0);
+			if (NULL != crossline_readline_text (pager.pattern, sizeof(pager.pattern), "/", 0, 1)) {
+				crossline_str_fold (pager.pattern, pager.pattern);
+				pager.match = -1;
+				crossline_pager_search (&pager, 1, page + 1);
+			}
+			crossline_cursor_hide (1);
+			break;
+		case 'n': case 'N':
+			crossline_pager_search (&pager, ('n' == ch) ? 1 : -1, page + 1);
+			break;
+		case 'q': case 'Q': case CTRL_KEY('C'): case CTRL_KEY('G'):
+			crossline_cursor_hide (0);
+			printf ("\x1b[?1049l");
+			fflush (stdout);
+			s_paging_print_line = 0;
+			if ((0 == crossline_atomic_add (&s_above.hold, -1)) && (0 == s_above.editing))
+				{ crossline_above_write (); } // output held while pager is shown
+			return 1;
+		}
+	}
+}
+
+/*****************************************************************************/
+
+/* Menu completion shows candidates in a bounded scrollable menu below input. Only visible rows are
+ * printed, and moving selection only reprints rows whose item or highlight is changed.
+ * Typing filters candidates by last word, other keys close menu and are handled by editor.
+ */
+typedef struct crossline_menu_t {
+	crossline_completions_t	*pCompletions;
+	int		*idx, num, max;		// Filtered item index
+	int		*drawn, rows;		// Item*2+selected drawn in each row, -1 is blank row, rows are reserved below input
+	int		item_rows, status;	// Rows for items, has status row
+	int		top, sel, word, word_len, col;	// First shown item, selected item, last word start, word width, cursor column
+	int		status_sel, status_num;	// Drawn status
+} crossline_menu_t;
+
+static crossline_menu_t s_menu;
+
+// Enable/Disable menu completion with max rows, return previous setting.
+int crossline_completion_menu_set (int enable, int max_rows)
+{
+	int prev = s_menu_on;
+	s_menu_on = enable;
+	s_menu_rows = (max_rows > 0) ? max_rows : 10;
+	return prev;
+}
+
+// Filter candidates by last word, narrow from current filtered items if word only grows.
+static void crossline_menu_filter (crossline_menu_t *menu, const char *buf, int num, int narrow)
+{
+	crossline_completion_item_t *items = menu->pCompletions->items;
+	int i, n = 0, len = num - menu->word, total = narrow ? menu->num : menu->pCompletions->num;
+	int *idx, match, width;
+	char pat[CROSS_HISTORY_BUF_LEN];
+
+	if (!narrow && (menu->max < total)) {
+		if (NULL == (idx = (int*)realloc (menu->idx, total * sizeof(int))))	{ menu->num = 0; return; }
+		menu->idx = idx;
+		menu->max = total;
+	}
+	menu->word_len = 0;
+	if (s_fuzzy_on)	{ len = crossline_fuzzy_pattern (pat, &buf[menu->word], len); }
+	for (i = 0; i < total; ++i) {
+		int id = narrow ? menu->idx[i] : i;
+		match = s_fuzzy_on ? (crossline_fuzzy_score (pat, len, items[id].word) >= 0) : !strncasecmp (items[id].word, &buf[menu->word], len);
+		if (match) {
+			menu->idx[n++] = id;
+			width = crossline_str_width (items[id].word);
+			if (width > menu->word_len)	{ menu->word_len = width; }
+		}
+	}
+	menu->num = n;
+	menu->top = menu->sel = 0;
+}
+
+// Print row at menu row r, cursor is at input end and is back after print.
+static void crossline_menu_row (crossline_menu_t *menu, int r, int cols)
+{
+	crossline_completion_item_t *item;
+	int i, len = 0, width = cols - 1, id = menu->top + r, sel;
+	char status[32];
+
+	crossline_cursor_move (r+1, -menu->col);
+	if (menu->status && (r == menu->rows - 1)) { // status row: hints and position
+		snprintf (status, sizeof(status), " [%d/%d]", menu->num ? menu->sel+1 : 0, menu->num);
+		crossline_color_set (menu->pCompletions->color_hints);
+		len = crossline_cells_print (menu->pCompletions->hints, width - (int)strlen(status));
+		crossline_color_set (CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_BLACK);
+		for (; len < width - (int)strlen(status); ++len) { printf (" "); }
+		len += printf ("%s", status);
+		menu->status_sel = menu->sel;
+		menu->status_num = menu->num;
+	} else if ((r < menu->item_rows) && (id < menu->num)) {
+		item = &menu->pCompletions->items[menu->idx[id]];
+		sel = (id == menu->sel);
+		crossline_color_set (sel ? s_menu_color : item->color_word);
+		len = crossline_cells_print (item->word, width);
+		if ('\0' != item->help[0]) {
+			for (; (len < width) && (len < menu->word_len + 4); ++len)	{ printf (" "); }
+			if (!sel)	{ crossline_color_set (item->color_help); }
+			len += crossline_cells_print (item->help, width - len);
+		}
+		menu->drawn[r] = menu->idx[id] * 2 + sel;
+	} else {
+		menu->drawn[r] = -1;
+	}
+	crossline_color_set (CROSSLINE_COLOR_DEFAULT);
+	for (i = len; i < width; ++i)	{ printf (" "); }
+	crossline_cursor_move (-(r+1), menu->col - width);
+}
+
+// Print menu rows which are changed.
+static void crossline_menu_draw (crossline_menu_t *menu, int cols)
+{
+	int r, id;
+	if (menu->sel < menu->top)	{ menu->top = menu->sel; }
+	if (menu->sel >= menu->top + menu->item_rows)	{ menu->top = menu->sel - menu->item_rows + 1; }
+	for (r = 0; r < menu->item_rows; ++r) {
+		id = menu->top + r;
+		if (menu->drawn[r] != ((id < menu->num) ? menu->idx[id] * 2 + (id == menu->sel) : -1))
+			{ crossline_menu_row (menu, r, cols); }
+	}
+	if (menu->status && ((menu->status_sel != menu->sel) || (menu->status_num != menu->num)))
+		{ crossline_menu_row (menu, menu->rows - 1, cols); }
+}
+
+// Reserve rows below input and print whole menu.
+static int crossline_menu_open (crossline_menu_t *menu)
+{
+	int r, rows, cols, *drawn;
+
+	crossline_screen_get (&rows, &cols);
+	menu->status = (menu->num > s_menu_rows) || ('\0' != menu->pCompletions->hints[0]);
+	menu->item_rows = (menu->num < s_menu_rows) ? menu->num : s_menu_rows;
+	if (menu->item_rows + menu->status > rows - 2)	{ menu->item_rows = rows - 2 - menu->status; }
+	if (menu->item_rows < 1)	{ return -1; }
+	menu->rows = menu->item_rows + menu->status;
+	if (NULL == (drawn = (int*)realloc (menu->drawn, menu->rows * sizeof(int))))	{ return -1; }
+	menu->drawn = drawn;
+	menu->col = s_cur_cell % cols; // cursor is at end of input
+	for (r = 0; r < menu->rows; ++r)	{ printf ("\n"); }
+	crossline_cursor_move (-menu->rows, menu->col);
+	for (r = 0; r < menu->rows; ++r)	{ menu->drawn[r] = -2; }
+	menu->status_num = -1;
+	crossline_menu_draw (menu, cols);
+	return 0;
+}
+
+// Erase menu rows.
+static void crossline_menu_close (crossline_menu_t *menu)
+{
+	int r, rows, cols;
+	crossline_screen_get (&rows, &cols);
+	menu->item_rows = menu->status = 0;
+	for (r = 0; r < menu->rows; ++r)	{ crossline_menu_row (menu, r, cols); }
+	menu->rows = 0;
+}
+
+/* Run menu completion, cursor must be at end of input. Return key which closes menu and
+ * should be handled by editor, 0 if key is consumed, -1 if menu can't be shown.
+ */
+static int crossline_menu_run (crossline_prompt_t *prompt, char *buf, int size, int *pCurPos, int *pCurNum, crossline_completions_t *pCompletions)
+{
+	crossline_menu_t *menu = &s_menu;
+	crossline_completion_item_t *item;
+	int ch, is_esc, rows, cols, len, num, input_rows;
+
+	menu->pCompletions = pCompletions;
+	for (menu->word = *pCurNum; (menu->word > 0) && (' ' != buf[menu->word-1]); --menu->word)	;
+	crossline_menu_filter (menu, buf, *pCurNum, 0);
+	if ((menu->num < 2) || (crossline_menu_open (menu) < 0))
+		{ return -1; }
+
+	for (;;) {
+		crossline_screen_get (&rows, &cols);
+		is_esc = 0;
+		ch = crossline_key_mapping (crossline_getkey (&is_esc));
+		num = *pCurNum;
+		switch (ch) {
+		case KEY_TAB:
+		case KEY_DOWN:
+		case CTRL_KEY('N'):
+			menu->sel = (menu->sel + 1) % menu->num;
+			break;
+		case KEY_UP:
+		case CTRL_KEY('P'):
+			menu->sel = (menu->sel + menu->num - 1) % menu->num;
+			break;
+		case KEY_PGDN:
+			menu->sel = (menu->sel + menu->item_rows < menu->num) ? menu->sel + menu->item_rows : menu->num - 1;
+			break;
+		case KEY_PGUP:
+			menu->sel = (menu->sel > menu->item_rows) ? menu->sel - menu->item_rows : 0;
+			break;
+		case KEY_ENTER:	// Accept selected word
+		case KEY_ENTER2:
+			item = &pCompletions->items[menu->idx[menu->sel]];
+			len = (int)strlen (item->word);
+			crossline_menu_close (menu);
+			if (s_frec_on)	{ crossline_frecency_add (item->word); }
+			if (menu->word + len + 1 < size) {
+				memcpy (&buf[menu->word], item->word, len);
+				buf[menu->word + len] = ' ';
+				crossline_refreash (prompt, buf, pCurPos, pCurNum, menu->word, *pCurNum, 0);
+				crossline_refreash (prompt, buf, pCurPos, pCurNum, menu->word+len+1, menu->word+len+1, menu->word+1);
+			}
+			return 0;
+		case CTRL_KEY('G'):	// Close menu
+		case CTRL_KEY('C'):
+			crossline_menu_close (menu);
+			return 0;
+		case KEY_BACKSPACE:
+		default:
+			if ((KEY_BACKSPACE == ch) ? (num <= menu->word) : ((ch <= ' ') || (ch > '~') || (num + 1 >= size))) {
+				crossline_menu_close (menu);
+				return ch;
+			}
+			// Edit last word and filter
+			input_rows = s_cur_cell / cols;
+			if (KEY_BACKSPACE == ch) {
+				num = crossline_char_prev (buf, num);
+			} else
+				{ buf[num++] = (char)ch; }
+			len = crossline_prompt_cells (prompt, cols);
+			if (!s_single_row && (crossline_cell_add (len, buf, num, cols) / cols != input_rows))	{ crossline_menu_close (menu); }
+			crossline_refreash (prompt, buf, pCurPos, pCurNum, num, num, (num < *pCurNum) ? 1 : num);
+			menu->col = s_cur_cell % cols;
+			crossline_menu_filter (menu, buf, num, KEY_BACKSPACE != ch);
+			if (0 == menu->num) {
+				if (menu->rows)	{ crossline_menu_close (menu); }
+				return 0;
+			}
+			if ((0 == menu->rows) && (crossline_menu_open (menu) < 0))
+				{ return 0; }
+			break;
+		}
+		crossline_menu_draw (menu, cols);
+	}
+}
+
+/*****************************************************************************/
+
 /* Internal readline from terminal. has_input indicates buf has inital input.
  * in_his will disable history and complete shortcuts
  */
-static char* crossline_readline_edit (char *buf, int size, const char *prompt, int has_input, int in_his)
+static char* crossline_readline_edit (char *buf, int size, crossline_prompt_t *prompt, int has_input, int in_his)
 {
 	int		pos = 0, num = 0, read_end = 0, is_esc;
-	int		ch, len, new_pos, copy_buf = 0, i, len2;
+	int		ch, len, new_pos, copy_buf = 0, i, j, len2, suggest_on = s_suggest_on, hl_on = s_hl.on, pending_key = 0, dominant;
 	uint32_t history_id = s_history_id, search_his;
-	char	input[CROSS_HISTORY_BUF_LEN];
-	crossline_completions_t		completions;
-
-	prompt = (NULL != prompt) ? prompt : "";
+	char	input[CROSS_HISTORY_BUF_LEN], utf8[4];
+	const char	*word;
+	crossline_completions_t		*pCompletions = &s_completions;
+
+	if (0 == s_delim->cls[0])	{ crossline_delim_build (s_delim); }
+	s_suggest_on = s_autosuggest && !in_his;
+	s_hl.on = (NULL != s_hl.func) && !in_his;
+	s_suggest_id = 0;
+	s_suggest_len = -1;
 	if (has_input) {
 		num = pos = (int)strlen (buf);
 		crossline_text_copy (input, buf, pos, num);
 	} else
 		{ buf[0] = input[0] = '\0'; }
+	crossline_above_init ();
+	crossline_atomic_add (&s_above.editing, 1);
 	crossline_print (prompt, buf, &pos, &num, pos, num);
 	crossline_winchg_reg ();
 
 	do {
 		is_esc = 0;
-		ch = crossline_getkey (&is_esc);
-		ch = crossline_key_mapping (ch);
+		if (pending_key) { // key closed completion menu
+			ch = pending_key;
+			pending_key = 0;
+		} else if (0 == (ch = crossline_async_wait (prompt, buf, &pos, &num))) {
+			if (!in_his)	{ crossline_live_hint (prompt, buf, &pos, &num); }
+			crossline_prompt_wait (prompt, buf, &pos, &num);
+			ch = crossline_getkey (&is_esc);
+			ch = crossline_key_mapping (ch);
+		}
 
 		if (s_got_resize) { // Handle window resizing for Linux, Windows can handle it automatically
 			new_pos = pos;
@@ -1083,11 +5777,13 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 		switch (ch) {
 /* Misc Commands */
 		case KEY_F1:	// Show help
+			crossline_ghost_clear (prompt, buf, &pos, &num);
 			crossline_show_help (in_his);
 			crossline_print (prompt, buf, &pos, &num, pos, num);
 			break;
 
 		case KEY_DEBUG:	// Enter keyboard debug mode
+			crossline_ghost_clear (prompt, buf, &pos, &num);
 			printf(" \b\nEnter keyboard debug mode, <Ctrl-C> to exit debug\n");
 			while (CTRL_KEY('C') != (ch=crossline_getch()))
 				{ printf ("%3d 0x%02x (%c)\n", ch, ch, isprint(ch) ? ch : ' '); }
@@ -1098,21 +5794,22 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 		case KEY_LEFT:	// Move back a character.
 		case CTRL_KEY('B'):
 			if (pos > 0)
-				{ crossline_refreash (prompt, buf, &pos, &num, pos-1, num, 0); }
+				{ crossline_refreash (prompt, buf, &pos, &num, crossline_char_prev (buf, pos), num, 0); }
 			break;
 
 		case KEY_RIGHT:	// Move forward a character.
 		case CTRL_KEY('F'):
+			if (crossline_suggest_accept (prompt, buf, size, &pos, &num, 0)) { break; }
 			if (pos < num)
-				{ crossline_refreash (prompt, buf, &pos, &num, pos+1, num, 0); }
+				{ crossline_refreash (prompt, buf, &pos, &num, crossline_char_next (buf, pos, num), num, 0); }
 			break;
 
 		case ALT_KEY('b'):	// Move back a word.
 		case ALT_KEY('B'):
 		case KEY_CTRL_LEFT:
 		case KEY_ALT_LEFT:
-			for (new_pos=pos-1; (new_pos > 0) && isdelim(buf[new_pos]); --new_pos)	;
-			for (; (new_pos > 0) && !isdelim(buf[new_pos]); --new_pos)	;
+			new_pos = crossline_word_rfind (buf, pos-1, 0, 0);
+			new_pos = crossline_word_rfind (buf, new_pos, 0, 1);
 			crossline_refreash (prompt, buf, &pos, &num, new_pos?new_pos+1:new_pos, num, 0);
 			break;
 
@@ -1120,8 +5817,9 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 		case ALT_KEY('F'):
 		case KEY_CTRL_RIGHT:
 		case KEY_ALT_RIGHT:
-			for (new_pos=pos; (new_pos < num) && isdelim(buf[new_pos]); ++new_pos)	;
-			for (; (new_pos < num) && !isdelim(buf[new_pos]); ++new_pos)	;
+			if (crossline_suggest_accept (prompt, buf, size, &pos, &num, 1)) { break; }
+			new_pos = crossline_word_find (buf, pos, num, 0);
+			new_pos = crossline_word_find (buf, new_pos, num, 1);
 			crossline_refreash (prompt, buf, &pos, &num, new_pos, num, 0);
 			break;
 
@@ -1132,6 +5830,7 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 
 		case CTRL_KEY('E'):	// Move cursor to end of line
 		case KEY_END:
+			if (crossline_suggest_accept (prompt, buf, size, &pos, &num, 0)) { break; }
 			crossline_refreash (prompt, buf, &pos, &num, num, num, 0);
 			break;
 
@@ -1142,53 +5841,53 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 
 		case KEY_CTRL_UP: // Move to up line
 		case KEY_ALT_UP:
-			crossline_updown_move (prompt, &pos, &num, -1, 1);
+			crossline_updown_move (prompt, buf, &pos, &num, -1, 1);
 			break;
 
 		case KEY_ALT_DOWN: // Move to down line
 		case KEY_CTRL_DOWN:
-			crossline_updown_move (prompt, &pos, &num, 1, 1);
+			crossline_updown_move (prompt, buf, &pos, &num, 1, 1);
 			break;
 
 /* Edit Commands */
 		case KEY_BACKSPACE: // Delete char to left of cursor (same with CTRL_KEY('H'))
 			if (pos > 0) {
-				memmove (&buf[pos-1], &buf[pos], num - pos);
-				crossline_refreash (prompt, buf, &pos, &num, pos-1, num-1, 1);
+				new_pos = crossline_char_prev (buf, pos);
+				memmove (&buf[new_pos], &buf[pos], num - pos);
+				crossline_refreash (prompt, buf, &pos, &num, new_pos, num - (pos-new_pos), 1);
 			}
 			break;
 
 		case KEY_DEL:	// Delete character under cursor
 		case CTRL_KEY('D'):
 			if (pos < num) {
-				memmove (&buf[pos], &buf[pos+1], num - pos - 1);
-				crossline_refreash (prompt, buf, &pos, &num, pos, num - 1, 1);
+				new_pos = crossline_char_next (buf, pos, num);
+				memmove (&buf[pos], &buf[new_pos], num - new_pos);
+				crossline_refreash (prompt, buf, &pos, &num, pos, num - (new_pos-pos), 1);
 			} else if ((0 == num) && (ch == CTRL_KEY('D'))) // On an empty line, EOF
 				 { printf (" \b\n"); read_end = -1; }
 			break;
 
 		case ALT_KEY('u'):	// Uppercase current or following word.
 		case ALT_KEY('U'):
-			for (new_pos = pos; (new_pos < num) && isdelim(buf[new_pos]); ++new_pos)	;
-			for (; (new_pos < num) && !isdelim(buf[new_pos]); ++new_pos)
+			for (new_pos = crossline_word_find (buf, pos, num, 0); (new_pos < num) && !isdelim(buf[new_pos]); ++new_pos)
 				{ buf[new_pos] = (char)toupper (buf[new_pos]); }
 			crossline_refreash (prompt, buf, &pos, &num, new_pos, num, 1);
 			break;
 
 		case ALT_KEY('l'):	// Lowercase current or following word.
 		case ALT_KEY('L'):
-			for (new_pos = pos; (new_pos < num) && isdelim(buf[new_pos]); ++new_pos)	;
-			for (; (new_pos < num) && !isdelim(buf[new_pos]); ++new_pos)
+			for (new_pos = crossline_word_find (buf, pos, num, 0); (new_pos < num) && !isdelim(buf[new_pos]); ++new_pos)
 				{ buf[new_pos] = (char)tolower (buf[new_pos]); }
 			crossline_refreash (prompt, buf, &pos, &num, new_pos, num, 1);
 			break;
 
 		case ALT_KEY('c'):	// Capitalize current or following word.
 		case ALT_KEY('C'):
-			for (new_pos = pos; (new_pos < num) && isdelim(buf[new_pos]); ++new_pos)	;
+			new_pos = crossline_word_find (buf, pos, num, 0);
 			if (new_pos<num)
 				{ buf[new_pos] = (char)toupper (buf[new_pos]); }
-			for (; new_pos<num && !isdelim(buf[new_pos]); ++new_pos)	;
+			new_pos = crossline_word_find (buf, new_pos, num, 1);
 			crossline_refreash (prompt, buf, &pos, &num, new_pos, num, 1);
 			break;
 
@@ -1201,16 +5900,14 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 			crossline_refreash (prompt, buf, &pos, &num, pos, num - (new_pos-pos), 1);
 			break;
 
-		case CTRL_KEY('T'): // Transpose previous character with current character.
-			if ((pos > 0) && !isdelim(buf[pos]) && !isdelim(buf[pos-1])) {
-				ch = buf[pos];
-				buf[pos] = buf[pos-1];
-				buf[pos-1] = (char)ch;
-				crossline_refreash (prompt, buf, &pos, &num, pos<num?pos+1:pos, num, 1);
-			} else if ((pos > 1) && !isdelim(buf[pos-1]) && !isdelim(buf[pos-2])) {
-				ch = buf[pos-1];
-				buf[pos-1] = buf[pos-2];
-				buf[pos-2] = (char)ch;
+		case CTRL_KEY('T'): // Transpose previous character with current character (whole UTF-8 graphemes).
+			new_pos = crossline_char_prev (buf, pos);
+			if ((pos > 0) && !isdelim(buf[pos]) && !isdelim(buf[new_pos])) {
+				len = crossline_char_next (buf, pos, num);
+				crossline_text_rotate (buf, new_pos, pos, len);
+				crossline_refreash (prompt, buf, &pos, &num, len, num, 1);
+			} else if ((new_pos > 0) && !isdelim(buf[new_pos]) && !isdelim(buf[crossline_char_prev (buf, new_pos)])) {
+				crossline_text_rotate (buf, crossline_char_prev (buf, new_pos), new_pos, pos);
 				crossline_refreash (prompt, buf, &pos, &num, pos, num, 1);
 			}
 			break;
@@ -1244,12 +5941,11 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 		case KEY_CTRL_BACKSPACE:
 			new_pos = pos;
 			if ((new_pos > 1) && isdelim(buf[new_pos-1]))	{ --new_pos; }
-			for (; (new_pos > 0) && isdelim(buf[new_pos]); --new_pos)	;
+			new_pos = crossline_word_rfind (buf, new_pos, 0, 0);
 			if (CTRL_KEY('W') == ch) {
 				for (; (new_pos > 0) && (' ' != buf[new_pos]); --new_pos)	;
-			} else {
-				for (; (new_pos > 0) && !isdelim(buf[new_pos]); --new_pos)	;
-			}
+			} else
+				{ new_pos = crossline_word_rfind (buf, new_pos, 0, 1); }
 			if ((new_pos>0) && (new_pos<pos) && isdelim(buf[new_pos]))	{ new_pos++; }
 			crossline_text_copy (s_clip_buf, buf, new_pos, pos);
 			memmove (&buf[new_pos], &buf[pos], num - pos);
@@ -1260,8 +5956,8 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 		case ALT_KEY('D'):
 		case KEY_ALT_DEL:
 		case KEY_CTRL_DEL:
-			for (new_pos = pos; (new_pos < num) && isdelim(buf[new_pos]); ++new_pos)	;
-			for (; (new_pos < num) && !isdelim(buf[new_pos]); ++new_pos)	;
+			new_pos = crossline_word_find (buf, pos, num, 0);
+			new_pos = crossline_word_find (buf, new_pos, num, 1);
 			crossline_text_copy (s_clip_buf, buf, pos, new_pos);
 			memmove (&buf[pos], &buf[new_pos], num - new_pos);
 			crossline_refreash (prompt, buf, &pos, &num, pos, num - (new_pos-pos), 1);
@@ -1281,38 +5977,70 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 		case KEY_TAB:		// Autocomplete (same with CTRL_KEY('I'))
 		case ALT_KEY('='):	// List possible completions.
 		case ALT_KEY('?'):
-			if (in_his || (NULL == s_completion_callback) || (pos != num))
+			if (in_his || (pos != num) || ((NULL == crossline_completion_source ()) && (NULL == s_completion_dict) &&
+				(NULL == s_completion_grammar)))
 				{ break; }
 			buf[pos] = '\0';
-			completions.num = 0;
-			completions.hints[0] = '\0';
-			s_completion_callback (buf, &completions);
-			if (completions.num >= 1) {
+			crossline_completions_reset (pCompletions);
+			if ((NULL != crossline_completion_source ()) && s_async_on) {
+				if (crossline_async_complete (buf, pCompletions, ch))	{ break; } // wait results
+			} else if (NULL != crossline_completion_source ())
+				{ crossline_completion_call (buf, pCompletions); }
+			if (NULL != s_completion_dict) { // complete last word
+				for (i = num; (i > 0) && (' ' != buf[i-1]); --i)	;
+				if (s_fuzzy_on && (i < num)) {
+					crossline_dict_fuzzy (s_completion_dict, &buf[i], pCompletions, s_fuzzy_top);
+				} else
+					{ crossline_dict_complete (s_completion_dict, &buf[i], pCompletions); }
+			}
+			if (NULL != s_completion_grammar)
+				{ crossline_grammar_complete (s_completion_grammar, buf, pCompletions); }
+			dominant = crossline_frecency_rank (pCompletions) && (0 != pCompletions->common_len);
+			if (pCompletions->num >= 1) {
 				if (KEY_TAB == ch) {
-					len2 = len = (int)strlen(completions.word[0]);
+					word = pCompletions->items[0].word;
+					len2 = len = (int)strlen(word);
+					if ((pCompletions->common_len >= 0) && (pCompletions->common_len < len) && !dominant)
+						{ len = pCompletions->common_len; }
 					// Find common string for autocompletion
-					for (i = 1; (i < completions.num) && (len > 0); ++i) {
-						while ((len > 0) && strncasecmp(completions.word[0], completions.word[i], len)) { len--; }
+					for (i = 1; (i < pCompletions->num) && (len > 0) && (pCompletions->common_len < 0) && !dominant; ++i) {
+						for (j = 0; (j < len) && (tolower(word[j]) == tolower(pCompletions->items[i].word[j])); ++j)	;
+						len = j;
 					}
 					if (len > 0) {
 						if (len2 > num) len2 = num;
-						while ((len2 > 0) && strncasecmp(completions.word[0], &buf[num-len2], len2)) { len2--; }
+						while ((len2 > 0) && strncasecmp(word, &buf[num-len2], len2)) { len2--; }
 						new_pos = num - len2;
-						if (new_pos+i+1 < size) {
-							for (i = 0; i < len; ++i) { buf[new_pos+i] = completions.word[0][i]; }
-							if (1 == completions.num) { buf[new_pos + (i++)] = ' '; }
+						if (s_fuzzy_on && (0 == len2)) { // fuzzy word replaces last word
+							while ((new_pos > 0) && (' ' != buf[new_pos-1])) { new_pos--; }
+						}
+						if (new_pos+len+1 < size) {
+							for (i = 0; i < len; ++i) { buf[new_pos+i] = word[i]; }
+							if (((1 == pCompletions->num) || dominant) && ('/' != word[len-1])) { buf[new_pos + (i++)] = ' '; } // directory keeps completing
 							crossline_refreash (prompt, buf, &pos, &num, new_pos+i, new_pos+i, 1);
+							if (s_frec_on && (len == (int)strlen (word)) && ((1 == pCompletions->num) || dominant))
+								{ crossline_frecency_add (word); }
 						}
 					}
 				}
 			}
-			if (((completions.num != 1) || (KEY_TAB != ch)) && crossline_show_completions(&completions))
+			if (((pCompletions->num != 1) && !dominant) || (KEY_TAB != ch) || (0 == pCompletions->common_len))
+				{ crossline_ghost_clear (prompt, buf, &pos, &num); }
+			if (s_menu_on && (KEY_TAB == ch) && (pCompletions->num > 1) && !dominant && !s_view.on) {
+				s_suggest_hide = 1;
+				pending_key = crossline_menu_run (prompt, buf, size, &pos, &num, pCompletions);
+				s_suggest_hide = 0;
+				if (pending_key >= 0)	{ break; }
+				pending_key = 0;
+			}
+			if ((((pCompletions->num != 1) && !dominant) || (KEY_TAB != ch) || (0 == pCompletions->common_len)) && 
+				crossline_show_completions(pCompletions))
 				{ crossline_print (prompt, buf, &pos, &num, pos, num); }
 			break;
 
 /* History Commands */
 		case KEY_UP:		// Fetch previous line in history.
-			if (crossline_updown_move (prompt, &pos, &num, -1, 0)) { break; } // check multi line move up
+			if (crossline_updown_move (prompt, buf, &pos, &num, -1, 0)) { break; } // check multi line move up
 		case CTRL_KEY('P'):
 			if (in_his) { break; }
 			if (!copy_buf)
@@ -1322,7 +6050,7 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 			break;
 
 		case KEY_DOWN:		// Fetch next line in history.
-			if (crossline_updown_move (prompt, &pos, &num, 1, 0)) { break; } // check multi line move down
+			if (crossline_updown_move (prompt, buf, &pos, &num, 1, 0)) { break; } // check multi line move down
 		case CTRL_KEY('N'):
 			if (in_his) { break; }
 			if (!copy_buf)
@@ -1363,6 +6091,7 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 		case CTRL_KEY('S'):
 		case KEY_F4:		// Search history with current input.
 			if (in_his) { break; }
+			crossline_ghost_clear (prompt, buf, &pos, &num);
 			crossline_text_copy (input, buf, 0, num);
 			search_his = crossline_history_search ((KEY_F4 == ch) ? buf : NULL);
 			if (search_his > 0)
@@ -1374,6 +6103,7 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 
 		case KEY_F2:	// Show history
 			if (in_his || (0 == s_history_id)) { break; }
+			crossline_ghost_clear (prompt, buf, &pos, &num);
 			printf (" \b\n");
 			crossline_history_show ();
 			crossline_print (prompt, buf, &pos, &num, pos, num);
@@ -1381,6 +6111,7 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 
 		case KEY_F3:	// Clear history
 			if (in_his) { break; }
+			crossline_ghost_clear (prompt, buf, &pos, &num);
 			printf(" \b\n!!! Confirm to clear history [y]: ");
 			if ('y' == crossline_getch()) {
 				printf(" \b\nHistory are cleared!");
@@ -1394,6 +6125,7 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 /* Control Commands */
 		case KEY_ENTER:		// Accept line (same with CTRL_KEY('M'))
 		case KEY_ENTER2:	// same with CTRL_KEY('J')
+			crossline_ghost_clear (prompt, buf, &pos, &num);
 			crossline_refreash (prompt, buf, &pos, &num, num, num, 0);
 			printf (" \b\n");
 			read_end = 1;
@@ -1401,6 +6133,7 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 
 		case CTRL_KEY('C'):	// Abort line.
 		case CTRL_KEY('G'):
+			crossline_ghost_clear (prompt, buf, &pos, &num);
 			crossline_refreash (prompt, buf, &pos, &num, num, num, 0);
 			if (CTRL_KEY('C') == ch)	{ printf (" \b^C\n"); }
 			else	{ printf (" \b\n"); }
@@ -1417,25 +6150,46 @@ static char* crossline_readline_edit (char *buf, int size, const char *prompt, i
 			break;
 
 		default:
-			if (!is_esc && isprint(ch) && (num < size-1)) {
-				memmove (&buf[pos+1], &buf[pos], num - pos);
-				buf[pos] = (char)ch;
-				crossline_refreash (prompt, buf, &pos, &num, pos+1, num+1, pos+1);
-				copy_buf = 0;
+			if (!is_esc && (isprint(ch) || ((ch >= 0x80) && (ch <= 0xFF)))) {
+				utf8[0] = (char)ch;
+				len = 1;
+#ifndef _WIN32	// read rest bytes of UTF-8 char, Windows gets code page bytes
+				len2 = ((ch & 0xE0) == 0xC0) ? 2 : ((ch & 0xF0) == 0xE0) ? 3 : ((ch & 0xF8) == 0xF0) ? 4 : 1;
+				if ((1 == len2) && (ch >= 0x80))	{ len = 0; } // stray continuation or invalid lead byte is dropped
+				while ((len > 0) && (len < len2)) {
+					ch = crossline_getch ();
+					if ((ch & 0xC0) != 0x80) { // truncated char is dropped
+						pending_key = crossline_key_mapping (ch);
+						len = 0;
+						break;
+					}
+					utf8[len++] = (char)ch;
+				}
+#endif
+				if ((len > 0) && (num + len < size)) {
+					memmove (&buf[pos+len], &buf[pos], num - pos);
+					memcpy (&buf[pos], utf8, len);
+					crossline_refreash (prompt, buf, &pos, &num, pos+len, num+len, pos+1);
+					copy_buf = 0;
+				}
 			}
 			break;
         } // switch( ch )
 	 	fflush(stdout);
 	} while ( !read_end );
 
+	s_suggest_on = suggest_on;
+	s_hl.on = hl_on;
+	if (!in_his)	{ crossline_async_cancel (); }
+	if ((0 == crossline_atomic_add (&s_above.editing, -1)) && (0 == s_above.hold))
+		{ crossline_above_write (); } // output left when line ends
 	if (read_end < 0) { return NULL; }
 	if ((num > 0) && (' ' == buf[num-1]))	{ num--; }
 	buf[num] = '\0';
 	if (!in_his && (num > 0) && strcmp(buf,"history")) { // Save history
 		if ((0 == s_history_id) || strncmp (buf, s_history_buf[(s_history_id-1)%CROSS_HISTORY_MAX_LINE], CROSS_HISTORY_BUF_LEN)) {
-			strncpy (s_history_buf[s_history_id % CROSS_HISTORY_MAX_LINE], buf, CROSS_HISTORY_BUF_LEN);
-			s_history_buf[s_history_id % CROSS_HISTORY_MAX_LINE][CROSS_HISTORY_BUF_LEN - 1] = '\0';
-			history_id = ++s_history_id;
+			crossline_history_add (buf);
+			history_id = s_history_id;
 			copy_buf = 0;
 		}
 	}
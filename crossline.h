@@ -76,9 +76,52 @@ extern char* crossline_readline (const char *prompt, char *buf, int size);
 // Same with crossline_readline except buf holding initial input for editing.
 extern char* crossline_readline2 (const char *prompt, char *buf, int size);
 
+/*
+ * Prompt object parsed once: SGR color sequences and wide chars take right width, newlines make multi-line prompt
+ * (only last line is redrawn with input). Dynamic prompt (ex. clock, git status) is got from callback again
+ * only after it's marked dirty.
+ */
+typedef struct crossline_prompt_t crossline_prompt_t;
+
+// Write prompt text to buf (size bytes) for dynamic prompt.
+typedef void (*crossline_prompt_callback) (char *buf, int size, void *arg);
+
+// Create prompt from text, or from callback if it's not NULL. Return NULL if no memory.
+extern crossline_prompt_t* crossline_prompt_create (const char *prompt, crossline_prompt_callback pCbFunc, void *arg);
+
+// Free prompt
+extern void  crossline_prompt_free (crossline_prompt_t *pPrompt);
+
+// Mark dynamic prompt to get from callback again, it can be called in other thread and prompt is redrawn while editing.
+extern void  crossline_prompt_dirty (crossline_prompt_t *pPrompt);
+
+// Same with crossline_readline but use prompt object.
+extern char* crossline_readline_prompt (crossline_prompt_t *pPrompt, char *buf, int size);
+
+// Print text above prompt from any thread, input is redrawn below it. Newline is added if text doesn't end with it.
+// Text is printed directly if no line is being edited. Return 0 on success, -1 if no memory.
+extern int   crossline_print_above (const char *text);
+
+// printf above prompt from any thread, same with crossline_print_above.
+extern int   crossline_printf_above (const char *fmt, ...);
+
 // Set move/cut word delimiter, default is all not digital and alphabetic characters.
 extern void  crossline_delimiter_set (const char *delim);
 
+// Delimiter presets: SQL keeps qualified names (schema.table_1.col) as one word, shell keeps paths and options as one word
+#define CROSSLINE_DELIM_SQL		" !\"#%&'()*+,-/:;<=>?@[\\]^`{|}~"
+#define CROSSLINE_DELIM_SHELL	" \"&'();<>`|"
+
+// Set delimiter of word profile (0-3), profile 0 is the one set by crossline_delimiter_set, return 0 if OK
+extern int   crossline_delimiter_profile_set (int profile, const char *delim);
+
+// Switch word motion and cut to delimiter profile, return previous profile or -1 if profile is invalid
+extern int   crossline_delimiter_profile_use (int profile);
+
+// Enable/Disable single row mode: long input doesn't wrap, it's scrolled horizontally around cursor with '<' '>' marks
+// for hidden text, so each refreash prints at most one screen row. Return previous setting.
+extern int   crossline_single_row_set (int enable);
+
 // Read a character from terminal without echo
 extern int	 crossline_getch (void);
 
@@ -99,6 +142,13 @@ extern void  crossline_history_show (void);
 // Clear history
 extern void  crossline_history_clear (void);
 
+// Enable/Disable history autosuggestion (ghost text after cursor), return previous setting
+// Right/End/Ctrl-F/Ctrl-E at end of line accept whole suggestion, Alt-F accepts one word
+extern int   crossline_autosuggest_set (int enable);
+
+// Set autosuggestion ghost text color, default is bright black (gray)
+extern void  crossline_autosuggest_color_set (crossline_color_e color);
+
 
 /*
  * Completion APIs
@@ -110,6 +160,14 @@ typedef void (*crossline_completion_callback) (const char *buf, crossline_comple
 // Register completion callback
 extern void  crossline_completion_register (crossline_completion_callback pCbFunc);
 
+// Add completion provider besides registered callback (priority 0), all are run in parallel on TAB.
+// Results are merged by priority (higher first) and add order, duplicated words are dropped.
+// max_num caps words from this provider (0 is unlimited). Return 0 if OK, -1 if too many providers.
+extern int   crossline_completion_provider_add (crossline_completion_callback pCbFunc, int priority, int max_num);
+
+// Remove completion provider
+extern void  crossline_completion_provider_remove (crossline_completion_callback pCbFunc);
+
 // Add completion in callback. Word is must, help for word is optional.
 extern void  crossline_completion_add (crossline_completions_t *pCompletions, const char *word, const char *help);
 
@@ -117,12 +175,157 @@ extern void  crossline_completion_add (crossline_completions_t *pCompletions, co
 extern void  crossline_completion_add_color (crossline_completions_t *pCompletions, const char *word, 
 														crossline_color_e wcolor, const char *help, crossline_color_e hcolor);
 
+// Add completion without copying, word and help must be valid until completion is done (ex. static strings).
+extern void  crossline_completion_add_static (crossline_completions_t *pCompletions, const char *word, const char *help);
+
+// Add completion with color without copying.
+extern void  crossline_completion_add_static_color (crossline_completions_t *pCompletions, const char *word, 
+														crossline_color_e wcolor, const char *help, crossline_color_e hcolor);
+
 // Set syntax hints in callback
 extern void  crossline_hints_set (crossline_completions_t *pCompletions, const char *hints);
 
 // Set syntax hints with color
 extern void  crossline_hints_set_color (crossline_completions_t *pCompletions, const char *hints, crossline_color_e color);
 
+// Enable/Disable live hints: when typing pauses for delay_ms (default 100), hints of completion callback and grammar
+// for current line are shown as ghost text after input. Callback isn't called for live hints in async mode. Return previous setting.
+extern int   crossline_hints_live_set (int enable, int delay_ms);
+
+// Declare results in callback are prefix-monotonic: results for longer last word are always a subset of these.
+// Then cached results can be filtered for longer last word instead of calling callback again.
+extern void  crossline_completion_monotonic_set (crossline_completions_t *pCompletions);
+
+// Enable callback results cache with TTL in ms, 0 to disable (default), <0 never expires. Return previous TTL.
+extern int   crossline_completion_cache_set (int ttl_ms);
+
+// Drop cached callback results, ex. data behind callback is changed.
+extern void  crossline_completion_cache_clear (void);
+
+// Enable/Disable async completion, callback runs in worker thread and editor keeps responsive with spinner.
+// Results are applied only if line is not changed, typing cancels running request.
+// deadline_ms > 0 applies partial results added so far when callback is slower. Return previous setting.
+extern int   crossline_completion_async_set (int enable, int deadline_ms);
+
+// Check in async callback whether request is cancelled (line changed or deadline passed), callback can stop early.
+extern int   crossline_completion_cancelled (crossline_completions_t *pCompletions);
+
+// Get latency in ms of last completion callback, -1 if no callback is finished.
+extern int   crossline_completion_latency (void);
+
+// Complete file name of last token, can be registered as completion callback or provider.
+// Quotes, '\' escapes (not in Windows) and leading ~/ are handled, directory listings are cached.
+extern void  crossline_completion_path (const char *buf, crossline_completions_t *pCompletions);
+
+// Enable/Disable frecency ranking: accepted words are counted with decay by half every half_life_hours (default 168),
+// completions are ordered by decayed count and TAB completes a word used much more than others. Return previous setting.
+extern int   crossline_completion_frecency_set (int enable, int half_life_hours);
+
+// Record accepted completion word, it's done by TAB and menu automatically.
+extern void  crossline_frecency_add (const char *word);
+
+// Save frecency store to hash table image file, load maps the file and enables frecency ranking. Return 0 if OK, -1 if fail.
+extern int   crossline_frecency_save (const char *filename);
+extern int   crossline_frecency_load (const char *filename);
+
+// Clear frecency store
+extern void  crossline_frecency_clear (void);
+
+// Enable/Disable menu completion, TAB shows candidates in scrollable menu with max_rows (default 10) below input.
+// TAB/Down/Up/PgDn/PgUp select, Enter accepts, typing filters, Ctrl-G closes menu. Return previous setting.
+extern int   crossline_completion_menu_set (int enable, int max_rows);
+
+
+/*
+ * Completion dictionary APIs
+ *   Case insensitive prefix trie to hold word lists, register once and look up by prefix in callback.
+ */
+
+typedef struct crossline_dict_t crossline_dict_t;
+
+// Create an empty dictionary, return NULL if no memory
+extern crossline_dict_t* crossline_dict_create (void);
+
+// Free dictionary
+extern void  crossline_dict_free (crossline_dict_t *pDict);
+
+// Add word to dictionary, help for word is optional. Return 0 if OK, -1 if fail.
+extern int   crossline_dict_add (crossline_dict_t *pDict, const char *word, const char *help);
+
+// Add word with color.
+extern int   crossline_dict_add_color (crossline_dict_t *pDict, const char *word, crossline_color_e wcolor, 
+														const char *help, crossline_color_e hcolor);
+
+// Add all words starting with prefix (case insensitive) to completions in callback, return number of words added.
+extern int   crossline_dict_complete (crossline_dict_t *pDict, const char *prefix, crossline_completions_t *pCompletions);
+
+// Save dictionary to compiled file (same byte order machine only), return 0 if OK, -1 if fail.
+extern int   crossline_dict_save (crossline_dict_t *pDict, const char *filename);
+
+// Load compiled dictionary file with read only memory mapping which is shared by all processes, return NULL if fail.
+// Loaded dictionary can't add words, use crossline_dict_free to unmap it.
+extern crossline_dict_t* crossline_dict_load (const char *filename);
+
+// Register dictionary to complete last word on TAB besides completion callback, NULL to unregister.
+extern void  crossline_dict_register (crossline_dict_t *pDict);
+
+// Add top_k best words fuzzy matching pattern (case insensitive subsequence) to completions by score,
+// return number of words added. Matches at word start, after separator, at camelCase hump and consecutive rank higher.
+extern int   crossline_dict_fuzzy (crossline_dict_t *pDict, const char *pattern, crossline_completions_t *pCompletions, int top_k);
+
+// Enable/Disable fuzzy matching of last word with registered dictionary and menu filter, keep top_k best words 
+// (default 200). Return previous setting.
+extern int   crossline_completion_fuzzy_set (int enable, int top_k);
+
+
+/*
+ * Completion grammar APIs
+ *   Declare command syntax, TAB completes keywords and values and shows placeholder hints automatically.
+ *   Syntax: KEYWORD, <placeholder>, [optional], {required | alternatives}, item... for repeat.
+ *   Ex: "SELECT <columns> FROM <table> [WHERE <condition>] [ORDER BY <column>]"
+ */
+
+typedef struct crossline_grammar_t crossline_grammar_t;
+
+// Value provider for placeholder type, add values starting with prefix to completions.
+typedef void (*crossline_grammar_provider) (const char *prefix, crossline_completions_t *pCompletions, void *arg);
+
+// Create an empty grammar, return NULL if no memory
+extern crossline_grammar_t* crossline_grammar_create (void);
+
+// Free grammar
+extern void  crossline_grammar_free (crossline_grammar_t *pGrammar);
+
+// Add command syntax, help is shown with command keywords (optional). Return 0 if OK, -1 if syntax error.
+extern int   crossline_grammar_add (crossline_grammar_t *pGrammar, const char *syntax, const char *help);
+
+// Add placeholder type for <name>, hint (default is name), hint color and value provider are optional.
+extern int   crossline_grammar_type_add (crossline_grammar_t *pGrammar, const char *name, const char *hint, 
+										crossline_color_e color, crossline_grammar_provider provider, void *arg);
+
+// Set colors for command keywords, command help and other keywords.
+extern void  crossline_grammar_color_set (crossline_grammar_t *pGrammar, crossline_color_e cmd_color, 
+										crossline_color_e help_color, crossline_color_e key_color);
+
+// Add completions and hints for last token of buf in callback, return number of words added.
+extern int   crossline_grammar_complete (crossline_grammar_t *pGrammar, const char *buf, crossline_completions_t *pCompletions);
+
+// Register grammar to complete on TAB besides completion callback, NULL to unregister.
+extern void  crossline_grammar_register (crossline_grammar_t *pGrammar);
+
+/*
+ * Highlight APIs
+ *   Color input as user types. Tokenizer callback scans one token a time, only tokens from the one before
+ *   edit are rescanned until a token starts where an old one did with same lexer state.
+ *   So callback must only depend on text from pos and *pState, not text before pos.
+ */
+
+// Scan token at buf[pos] (num is input length), set its color and update *pState to lexer state after token
+// (ex. inside quote or comment, starts with 0). Return token length.
+typedef int (*crossline_highlight_callback) (const char *buf, int pos, int num, int *pState, crossline_color_e *pColor, void *arg);
+
+// Register highlighter, NULL to unregister.
+extern void  crossline_highlight_register (crossline_highlight_callback pCbFunc, void *arg);
 
 /*
  * Paging APIs
@@ -135,6 +338,23 @@ extern int crossline_paging_set (int enable);
 // if you know only one line is printed, just give line_len = 1
 extern int  crossline_paging_check (int line_len);
 
+// Write len bytes (-1 for string) with paging, output is buffered and wrapped rows are counted for you,
+// return 1 means quit and rest output is dropped until flush, 0 means continue
+extern int  crossline_paging_write (const char *text, int len);
+
+// printf with paging, return is same as crossline_paging_write
+extern int  crossline_paging_printf (const char *fmt, ...);
+
+// Write buffered output, must be called after paging writes
+extern void crossline_paging_flush (void);
+
+// Get line idx (0 to num-1) for pager, line can be written to buf (size bytes) and can have SGR color sequences.
+typedef const char* (*crossline_pager_callback) (int idx, char *buf, int size, void *arg);
+
+// Show num lines in full-screen pager (Up/Down/PgUp/PgDn scroll, / search) if they don't fit screen,
+// lines are got from callback only when shown. Otherwise or for Windows console they're printed with paging check.
+extern void crossline_pager_show (const char *title, int num, crossline_pager_callback pCbFunc, void *arg);
+
 
 /* 
  * Cursor APIs
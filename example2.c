@@ -26,7 +26,14 @@ gcc -Wall crossline.c example2.c -o example2
 	#define strncasecmp				_strnicmp
 #endif
 
+static crossline_dict_t *s_cmd_dict = NULL;
+
 static void completion_hook (char const *buf, crossline_completions_t *pCompletion)
+{
+	crossline_dict_complete (s_cmd_dict, buf, pCompletion);
+}
+
+static void completion_dict_build ()
 {
 	int i;
 	crossline_color_e wcolor, hcolor;
@@ -46,16 +53,15 @@ static void completion_hook (char const *buf, crossline_completions_t *pCompleti
 		"Do paing APIs test       ",
 		"Do Color APIs test       "};
 
+	s_cmd_dict = crossline_dict_create ();
 	for (i = 0; NULL != cmd[i]; ++i) {
-		if (0 == strncasecmp(buf, cmd[i], strlen(buf))) {
-			if (i < 8) { 
-				wcolor = CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_YELLOW; 
-			} else { 
-				wcolor = CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_CYAN; 
-			}
-			hcolor = i%2 ? CROSSLINE_FGCOLOR_WHITE : CROSSLINE_FGCOLOR_CYAN;
-			crossline_completion_add_color (pCompletion, cmd[i], wcolor, cmd_help[i], hcolor);
+		if (i < 8) { 
+			wcolor = CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_YELLOW; 
+		} else { 
+			wcolor = CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_CYAN; 
 		}
+		hcolor = i%2 ? CROSSLINE_FGCOLOR_WHITE : CROSSLINE_FGCOLOR_CYAN;
+		crossline_dict_add_color (s_cmd_dict, cmd[i], wcolor, cmd_help[i], hcolor);
 	}
 }
 
@@ -64,11 +70,11 @@ static void pagint_test ()
 	int i;
 	crossline_paging_set (1);
 	for (i = 0; i < 256; ++i) {
-		printf ("Paging test: %3d\n", i);
-		if (crossline_paging_check (sizeof("paging test: ") + 3)) {
+		if (crossline_paging_printf ("Paging test: %3d\n", i)) {
 			break;
 		}
 	}
+	crossline_paging_flush ();
 }
 
 static void color_test ()
@@ -187,6 +193,7 @@ int main ()
 {
 	char buf[1024]="select ";
 
+	completion_dict_build ();
 	crossline_completion_register (completion_hook);
 	crossline_history_load ("history.txt");
 	crossline_prompt_color_set (CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_GREEN);
@@ -212,5 +219,6 @@ int main ()
 	}
 
 	crossline_history_save ("history.txt");
+	crossline_dict_free (s_cmd_dict);
 	return 0;
 }
@@ -0,0 +1,81 @@
+/*
+
+Build
+
+# Windows MSVC
+cl -D_CRT_SECURE_NO_WARNINGS -W4 User32.Lib crossline.c example_dict.c /Feexample_dict.exe
+
+# Windows Clang
+clang -D_CRT_SECURE_NO_WARNINGS -Wall -lUser32 crossline.c example_dict.c -o example_dict.exe
+
+# Linux Clang
+clang -Wall crossline.c example_dict.c -o example_dict
+
+# GCC(Linux, MinGW, Cygwin, MSYS2)
+gcc -Wall crossline.c example_dict.c -o example_dict
+
+Usage
+
+# Compile word list (one "word<TAB>help" per line, help is optional) to dictionary file
+example_dict -b words.txt words.dict
+
+# Map dictionary file and complete words with <TAB>
+example_dict words.dict
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "crossline.h"
+
+static int dict_build (const char *txt_file, const char *dict_file)
+{
+	char line[1024], *help, *end;
+	int count = 0, ret;
+	crossline_dict_t *pDict;
+	FILE *file = fopen (txt_file, "r");
+
+	if (NULL == file) {
+		printf ("Can't open %s\n", txt_file);
+		return -1;
+	}
+	pDict = crossline_dict_create ();
+	while ((NULL != pDict) && (NULL != fgets (line, sizeof(line), file))) {
+		for (end = line + strlen(line); (end > line) && (('\n' == end[-1]) || ('\r' == end[-1])); --end)
+			{ *(end-1) = '\0'; }
+		help = strchr (line, '\t');
+		if (NULL != help)	{ *help++ = '\0'; }
+		if (0 == crossline_dict_add (pDict, line, help))	{ count++; }
+	}
+	fclose (file);
+	ret = crossline_dict_save (pDict, dict_file);
+	printf ("%s %d words to %s\n", ret ? "Fail to save" : "Saved", count, dict_file);
+	crossline_dict_free (pDict);
+	return ret;
+}
+
+int main (int argc, char *argv[])
+{
+	char buf[256];
+	crossline_dict_t *pDict;
+
+	if ((4 == argc) && !strcmp (argv[1], "-b"))
+		{ return dict_build (argv[2], argv[3]) ? 1 : 0; }
+	if (2 != argc) {
+		printf ("Usage: %s -b words.txt words.dict\n       %s words.dict\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	pDict = crossline_dict_load (argv[1]);
+	if (NULL == pDict) {
+		printf ("Can't load dictionary %s\n", argv[1]);
+		return 1;
+	}
+	crossline_dict_register (pDict);
+	while (NULL != crossline_readline ("Dict> ", buf, sizeof(buf))) {
+		printf ("Read line: \"%s\"\n", buf);
+	}
+	crossline_dict_free (pDict);
+	return 0;
+}
@@ -1,17 +1,16 @@
 /*
 
-This Example implements a simple SQL syntax parser.
-	INSERT INTO <table> SET column1=value1,column2=value2,...
-	SELECT <* | column1,columnm2,...> FROM <table> [WHERE] [ORDER BY] [LIMIT] [OFFSET]
-	UPDATE <table> SET column1=value1,column2=value2 [WHERE] [ORDER BY] [LIMIT] [OFFSET]
-	DELETE FROM <table> [WHERE] [ORDER BY] [LIMIT] [OFFSET]
-	CREATE [UNIQUE] INDEX <name> ON <table> (column1,column2,...)
-	DROP {TABLE | INDEX} <name>
+This Example declares a simple SQL syntax with completion grammar.
+	INSERT INTO <table> SET <column=value>...
+	SELECT {* | <column>...} FROM <table> [WHERE <condition>] [ORDER BY <column>] [LIMIT <number>] [OFFSET <number>]
+	UPDATE <table> SET <column=value>... [WHERE <condition>] [ORDER BY <column>] [LIMIT <number>] [OFFSET <number>]
+	DELETE FROM <table> [WHERE <condition>] [ORDER BY <column>] [LIMIT <number>] [OFFSET <number>]
+	CREATE [UNIQUE] INDEX <index> ON <table> <(column1,column2,...)>
+	DROP {TABLE <table> | INDEX <index>}
 	SHOW {TABLES | DATABASES}
-	DESCRIBE <TABLE>
+	DESCRIBE <table>
 	help {INSERT | SELECT | UPDATE | DELETE | CREATE | DROP | SHOW | DESCRIBE | help | exit | history}
 
-
 Build
 
 # Windows MSVC
@@ -31,6 +30,7 @@ gcc -Wall crossline.c example_sql.c -o example_sql
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include "crossline.h"
 
 #ifdef _WIN32
@@ -38,199 +38,95 @@ gcc -Wall crossline.c example_sql.c -o example_sql
 	#define strncasecmp				_strnicmp
 #endif
 
-void sql_add_completion (crossline_completions_t *pCompletion, const char *prefix, const char **match, const char **help)
-{
-	int i, len = (int)strlen(prefix);
-	crossline_color_e wcolor, hcolor;
-	for (i = 0;  NULL != match[i]; ++i) {
-		if (0 == strncasecmp(prefix, match[i], len)) {
-			if (NULL != help) {
-				if (i < 8) { 
-					wcolor = CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_YELLOW; 
-				} else { 
-					wcolor = CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_CYAN; 
-				}
-				hcolor = i%2 ? CROSSLINE_FGCOLOR_WHITE : CROSSLINE_FGCOLOR_CYAN;
-				crossline_completion_add_color (pCompletion, match[i], wcolor, help[i], hcolor);
-			} else {
-				crossline_completion_add_color (pCompletion, match[i], CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_MAGENTA, NULL, 0);
-			}
-		}
-	}
-}
+static const char* s_sql_syntax[][2] = {
+	{"INSERT INTO <table> SET <column=value>...",								"Insert a record to table"},
+	{"SELECT {* | <column>...} FROM <table> [WHERE <condition>] [ORDER BY <column>] [LIMIT <number>] [OFFSET <number>]",
+																				"Select records from table"},
+	{"UPDATE <table> SET <column=value>... [WHERE <condition>] [ORDER BY <column>] [LIMIT <number>] [OFFSET <number>]",
+																				"Update records in table"},
+	{"DELETE FROM <table> [WHERE <condition>] [ORDER BY <column>] [LIMIT <number>] [OFFSET <number>]",
+																				"Delete records from table"},
+	{"CREATE [UNIQUE] INDEX <index> ON <table> <(column1,column2,...)>",		"Create index on table"},
+	{"DROP {TABLE <table> | INDEX <index>}",									"Drop index or table"},
+	{"SHOW {TABLES | DATABASES}",												"Show tables or databases"},
+	{"DESCRIBE <table>",														"Show table schema"},
+	{"help {INSERT | SELECT | UPDATE | DELETE | CREATE | DROP | SHOW | DESCRIBE | help | exit | history}",
+																				"Show help for topic"},
+	{"exit",																	"Exit shell"},
+	{"history",																	"Show history"},
+};
 
-int sql_find_key (const char **match, const char *prefix)
+static void sql_table_provider (const char *prefix, crossline_completions_t *pCompletions, void *arg)
 {
+	static const char* sql_tables[] = {"customer", "orders", "product", "supplier", NULL};
 	int i;
-	for (i = 0; NULL != match[i]; ++i) {
-		if (0 == strcasecmp(prefix, match[i])) {
-		  return i;
+	(void)arg;
+	for (i = 0; NULL != sql_tables[i]; ++i) {
+		if (0 == strncasecmp (prefix, sql_tables[i], strlen(prefix))) {
+			crossline_completion_add_static_color (pCompletions, sql_tables[i], CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_GREEN, NULL, 0);
 		}
 	}
-	return -1;
 }
 
-enum {
-	CMD_INSERT,
-	CMD_SELECT,
-	CMD_UPDATE,
-	CMD_DELETE,
-	CMD_CREATE,
-	CMD_DROP,
-	CMD_SHOW,
-	CMD_DESCRIBE,
-	CMD_HELP,
-	CMD_EXIT,
-	CMD_HISTORY,
-};
-
-void sql_completion_hook (char const *buf, crossline_completions_t *pCompletion)
+static crossline_grammar_t* sql_grammar_build (void)
 {
-	int	num, cmd, bUnique = 0;
-	char split[8][128], last_ch;
-	static const char* sql_cmd[] = {"INSERT", "SELECT", "UPDATE", "DELETE", "CREATE", "DROP", "SHOW", "DESCRIBE", "help", "exit", "history", NULL};
-	static const char* sql_cmd_help[] = {
-		"Insert a record to table",
-		"Select records from table",
-		"Update records in table",
-		"Delete records from table",
-		"Create index on table",
-		"Drop index or table",
-		"Show tables or databases",
-		"Show table schema",
-		"Show help for topic",
-		"Exit shell",
-		"Show history"};
-	static const char* sql_caluse[] = {"WHERE", "ORDER BY", "LIMIT", "OFFSET", NULL};
-	static const char* sql_index[]  = {"UNIQUE", "INDEX", NULL};
-	static const char* sql_drop[]   = {"TABLE", "INDEX", NULL};
-	static const char* sql_show[]   = {"TABLES", "DATABASES", NULL};
+	unsigned int i;
 	crossline_color_e tbl_color = CROSSLINE_FGCOLOR_WHITE | CROSSLINE_BGCOLOR_GREEN;
 	crossline_color_e col_color = CROSSLINE_FGCOLOR_WHITE | CROSSLINE_BGCOLOR_CYAN;	
 	crossline_color_e idx_color = CROSSLINE_FGCOLOR_WHITE | CROSSLINE_BGCOLOR_YELLOW;
+	crossline_grammar_t *pGrammar = crossline_grammar_create ();
+
+	if (NULL == pGrammar)	{ return NULL; }
+	crossline_grammar_color_set (pGrammar, CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_YELLOW, CROSSLINE_FGCOLOR_CYAN, 
+								CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_MAGENTA);
+	crossline_grammar_type_add (pGrammar, "table", "table name", tbl_color, sql_table_provider, NULL);
+	crossline_grammar_type_add (pGrammar, "index", "index name", idx_color, NULL, NULL);
+	crossline_grammar_type_add (pGrammar, "column", "column name", col_color, NULL, NULL);
+	crossline_grammar_type_add (pGrammar, "column=value", "column1=value1 column2=value2 ...", col_color, NULL, NULL);
+	crossline_grammar_type_add (pGrammar, "(column1,column2,...)", NULL, col_color, NULL, NULL);
+	for (i = 0; i < sizeof(s_sql_syntax) / sizeof(s_sql_syntax[0]); ++i) {
+		if (crossline_grammar_add (pGrammar, s_sql_syntax[i][0], s_sql_syntax[i][1]) < 0)
+			{ printf ("Invalid syntax: %s\n", s_sql_syntax[i][0]); }
+	}
+	return pGrammar;
+}
 
-	memset (split, '\0', sizeof (split));
-	num = sscanf (buf, "%s %s %s %s %s %s %s %s", split[0], split[1], split[2], split[3], split[4], split[5], split[6], split[7]);
-	cmd = sql_find_key (sql_cmd, split[0]);
-
-	if ((cmd < 0) && (num <= 1)) {
-		sql_add_completion (pCompletion, split[0], sql_cmd, sql_cmd_help);
+// Highlight SQL keywords, numbers and quoted strings, one token a time.
+static int sql_highlight (const char *buf, int pos, int num, int *pState, crossline_color_e *pColor, void *arg)
+{
+	static const char* sql_keywords[] = {"INSERT", "INTO", "SET", "SELECT", "FROM", "WHERE", "ORDER", "BY", "LIMIT", 
+		"OFFSET", "UPDATE", "DELETE", "CREATE", "UNIQUE", "INDEX", "ON", "DROP", "TABLE", "SHOW", "TABLES", 
+		"DATABASES", "DESCRIBE", "AND", "OR", "NOT", NULL};
+	int i, len = 1;
+	char ch = buf[pos];
+	(void)pState; (void)arg;
+
+	if ('\'' == ch) { // string to closing quote or end
+		for (; (pos + len < num) && ('\'' != buf[pos + len]); ++len)	;
+		*pColor = CROSSLINE_FGCOLOR_GREEN;
+		return (pos + len < num) ? len + 1 : len;
 	}
-	last_ch = buf[strlen(buf) - 1];
-	switch (cmd) {
-	case CMD_INSERT: // INSERT INTO <table> SET column1=value1,column2=value2,...
-		if ((1 == num) && (' ' == last_ch)) {
-			crossline_completion_add (pCompletion, "INTO", NULL);
-		} else if ((2 == num) && (' ' == last_ch)) {
-			crossline_hints_set_color (pCompletion, "table name", tbl_color);
-		} else if ((3 == num) && (' ' == last_ch)) {
-			crossline_completion_add (pCompletion, "SET", NULL);
-		} else if ((4 == num) && (' ' == last_ch)) {
-			crossline_hints_set_color (pCompletion, "column1=value1,column2=value2,...", col_color);
-		}
-		break;
-	case CMD_SELECT: // SELECT < * | column1,columnm2,...> FROM <table> [WHERE] [ORDER BY] [LIMIT] [OFFSET]
-		if ((1 == num) && (' ' == last_ch)) {
-			crossline_hints_set_color (pCompletion, "* | column1,columnm2,...", col_color);
-		} else if ((2 == num) && (' ' == last_ch)) {
-			crossline_completion_add (pCompletion, "FROM", NULL);
-		} else if ((3 == num) && (' ' == last_ch)) {
-			crossline_hints_set_color (pCompletion, "table name", tbl_color);
-		} else if ((4 == num) && (' ' == last_ch)) {
-			sql_add_completion (pCompletion, "", sql_caluse, NULL);
-		} else if ((num > 4) && (' ' != last_ch)) {
-			sql_add_completion (pCompletion, split[num-1], sql_caluse, NULL);
-		}
-		break;
-	case CMD_UPDATE: // UPDATE <table> SET column1=value1,column2=value2 [WHERE] [ORDER BY] [LIMIT] [OFFSET]
-		if ((1 == num) && (' ' == last_ch)) {
-			crossline_hints_set_color (pCompletion, "table name", tbl_color);
-		} else if ((2 == num) && (' ' == last_ch)) {
-			crossline_completion_add (pCompletion, "SET", NULL);
-		} else if ((3 == num) && (' ' == last_ch)) {
-			crossline_hints_set_color (pCompletion, "column1=value1,column2=value2,...", col_color);
-		} else if ((4 == num) && (' ' == last_ch)) {
-			sql_add_completion (pCompletion, "", sql_caluse, NULL);
-		} else if ((num > 4) && (' ' != last_ch)) {
-			sql_add_completion (pCompletion, split[num-1], sql_caluse, NULL);
-		}
-		break;
-	case CMD_DELETE: // DELETE FROM <table> [WHERE] [ORDER BY] [LIMIT] [OFFSET]
-		if ((1 == num) && (' ' == last_ch)) {
-			crossline_completion_add (pCompletion, "FROM", NULL);
-		} else if ((2 == num) && (' ' == last_ch)) {
-			crossline_hints_set_color (pCompletion, "table name", tbl_color);
-		} else if ((3 == num) && (' ' == last_ch)) {
-			sql_add_completion (pCompletion, "", sql_caluse, NULL);
-		} else if ((num > 3) && (' ' != last_ch)) {
-			sql_add_completion (pCompletion, split[num-1], sql_caluse, NULL);
-		}
-		break;
-	case CMD_CREATE: // CREATE [UNIQUE] INDEX <name> ON <table> (column1,column2,...)
-		if ((1 == num) && (' ' == last_ch)) {
-			sql_add_completion (pCompletion, "", sql_index, NULL);
-		} else if ((2 == num) && (' ' != last_ch)) {
-			sql_add_completion (pCompletion, split[1], sql_index, NULL);
-		} else {
-			if ((num >= 2) && !strcasecmp (split[1], "UNIQUE")) {
-				bUnique = 1;
-			}
-			if ((2 == num) && bUnique && (' ' == last_ch)) {
-				crossline_completion_add (pCompletion, "INDEX", NULL);
-			}
-			else if ((2+bUnique == num) && (' ' == last_ch)) {
-				crossline_hints_set_color (pCompletion, "index name", idx_color);
-			} else if ((3+bUnique == num) && (' ' == last_ch)) {
-				crossline_completion_add (pCompletion, "ON", NULL);
-			} else if ((4+bUnique == num) && (' ' == last_ch)) {
-				crossline_hints_set_color (pCompletion, "table name", tbl_color);
-			} else if ((5+bUnique == num) && (' ' == last_ch)) {
-				crossline_hints_set_color (pCompletion, "(column1,column2,...)", col_color);
-			}
-		}
-		break;
-	case CMD_DROP:	// DROP TABLE <name>, DROP INDEX <name>
-		if ((1 == num) && (' ' == last_ch)) {
-			sql_add_completion (pCompletion, "", sql_drop, NULL);
-		} else if ((2 == num) && (' ' != last_ch)) {
-			sql_add_completion (pCompletion, split[1], sql_drop, NULL);
-		} else if ((num == 2) && (' ' == last_ch)) {
-			if (!strcasecmp (split[1], "TABLE")) {
-				crossline_hints_set_color (pCompletion, "table name", tbl_color);
-			} else if (!strcasecmp (split[1], "INDEX")) {
-				crossline_hints_set_color (pCompletion, "index name", idx_color);
-			}
-		}
-		break;
-	case CMD_SHOW: // SHOW TABLES, SHOW DATABASES
-		if ((1 == num) && (' ' == last_ch)) {
-			sql_add_completion (pCompletion, "", sql_show, NULL);
-		} else if ((2 == num) && (' ' != last_ch)) {
-			sql_add_completion (pCompletion, split[1], sql_show, NULL);
-		}
-		break;
-	case CMD_DESCRIBE: // describe <table>
-		if (' ' == last_ch) {
-			crossline_hints_set_color (pCompletion, "table name", tbl_color);
-		}
-		break;
-	case CMD_HELP:
-		if ((1 == num) && (' ' == last_ch)) {
-			sql_add_completion (pCompletion, "", sql_cmd, NULL);
-		} else if ((2 == num) && (' ' != last_ch)) {
-			sql_add_completion (pCompletion, split[1], sql_cmd, NULL);
+	if (!isalnum ((unsigned char)ch) && ('_' != ch))	{ return 1; }
+	for (; (pos + len < num) && (isalnum ((unsigned char)buf[pos + len]) || ('_' == buf[pos + len])); ++len)	;
+	if (isdigit ((unsigned char)ch)) {
+		*pColor = CROSSLINE_FGCOLOR_MAGENTA;
+	} else {
+		for (i = 0; NULL != sql_keywords[i]; ++i) {
+			if (((int)strlen (sql_keywords[i]) == len) && !strncasecmp (sql_keywords[i], &buf[pos], len))
+				{ *pColor = CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_YELLOW; break; }
 		}
-		break;
-	case CMD_EXIT:
-		break;
 	}
+	return len;
 }
 
 int main ()
 {
 	char buf[256];
+	crossline_grammar_t *pGrammar = sql_grammar_build ();
 
-	crossline_completion_register (sql_completion_hook);
+	crossline_grammar_register (pGrammar);
+	crossline_highlight_register (sql_highlight, NULL);
+	crossline_hints_live_set (1, 0);
 	crossline_history_load ("history.txt");
 	crossline_prompt_color_set (CROSSLINE_FGCOLOR_BRIGHT | CROSSLINE_FGCOLOR_GREEN);
 
@@ -244,5 +140,6 @@ int main ()
 	}
 
 	crossline_history_save ("history.txt");
+	crossline_grammar_free (pGrammar);
 	return 0;
 }